@@ -0,0 +1,1015 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "baked.h"
+#include "bench.h"
+#include "delta.h"
+#include "fb_verify.h"
+#include "gpu_addr.h"
+#include "journal.h"
+#include "mem_flush.h"
+#include "mem_map.h"
+#include "pacing.h"
+#include "reg_batch.h"
+#include "trace_check.h"
+
+namespace Baked {
+
+// --- buffered output ------------------------------------------------------
+
+namespace {
+
+// Register snapshots are taken every this many frames during compilation.
+const u32 kKeyframeInterval = 64;
+
+class Writer {
+public:
+    bool Open(const char* path) {
+        if (R_FAILED(FSUSER_OpenArchive(&sdmc, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""))))
+            return false;
+
+        FSUSER_DeleteFile(sdmc, fsMakePath(PATH_ASCII, path));
+        if (R_FAILED(FSUSER_OpenFile(&file, sdmc, fsMakePath(PATH_ASCII, path),
+                                     FS_OPEN_WRITE | FS_OPEN_CREATE, 0))) {
+            FSUSER_CloseArchive(sdmc);
+            sdmc = 0;
+            return false;
+        }
+
+        buffer = (u8*)malloc(BufferSize);
+        return buffer != nullptr;
+    }
+
+    bool Write(const void* data, u32 size) {
+        const u8* src = (const u8*)data;
+        while (size > 0) {
+            u32 chunk = BufferSize - used;
+            if (chunk > size)
+                chunk = size;
+            memcpy(buffer + used, src, chunk);
+            used += chunk;
+            src += chunk;
+            size -= chunk;
+            if (used == BufferSize && !Drain())
+                return false;
+        }
+        return true;
+    }
+
+    bool WriteAt(u64 offset, const void* data, u32 size) {
+        if (!Drain())
+            return false;
+        u32 written = 0;
+        Result res = FSFILE_Write(file, &written, offset, data, size, FS_WRITE_FLUSH);
+        return R_SUCCEEDED(res) && written == size;
+    }
+
+    void Close(bool keep) {
+        if (file) {
+            if (keep)
+                Drain();
+            FSFILE_Close(file);
+            file = 0;
+        }
+        if (sdmc) {
+            FSUSER_CloseArchive(sdmc);
+            sdmc = 0;
+        }
+        free(buffer);
+        buffer = nullptr;
+    }
+
+    u64 Position() const { return file_pos + used; }
+
+private:
+    static const u32 BufferSize = 128 * 1024;
+
+    bool Drain() {
+        if (used == 0)
+            return true;
+        u32 written = 0;
+        Result res = FSFILE_Write(file, &written, file_pos, buffer, used, 0);
+        if (R_FAILED(res) || written != used)
+            return false;
+        file_pos += used;
+        used = 0;
+        return true;
+    }
+
+    Handle file = 0;
+    FS_Archive sdmc = 0;
+    u8* buffer = nullptr;
+    u32 used = 0;
+    u64 file_pos = 0;
+};
+
+// Payloads are padded so every op record stays 16-byte aligned in the file.
+u32 PadPayload(u32 size) {
+    return (size + 15) & ~15u;
+}
+
+u32 ResolveValue(u32 value, u32 kind, u32 arena_phys) {
+    switch (kind) {
+    case kArenaShift3:
+        return (arena_phys + value) >> 3;
+    case kArenaRaw:
+        return arena_phys + value;
+    default:
+        return value;
+    }
+}
+
+// Shadow of the external register file in baked (value, kind) form,
+// maintained during compilation to emit keyframe snapshots.
+struct RegShadow {
+    static const u32 MaxWords = 0x1A00 / 4;
+
+    u8 written[MaxWords];
+    u32 value[MaxWords];
+    u32 kind[MaxWords];
+
+    void Reset() { memset(written, 0, sizeof(written)); }
+
+    void Note(u32 offset, u32 val, u32 knd) {
+        u32 i = offset / 4;
+        if (i >= MaxWords || IsTriggerReg(offset))
+            return;
+        written[i] = 1;
+        value[i] = val;
+        kind[i] = knd;
+    }
+
+    void Emit(std::vector<u8>* blob) const {
+        u32 count = 0;
+        for (u32 i = 0; i < MaxWords; i++)
+            count += written[i];
+
+        size_t base = blob->size();
+        blob->resize(base + 4 + count * sizeof(SnapshotReg));
+        memcpy(blob->data() + base, &count, 4);
+
+        SnapshotReg* regs = (SnapshotReg*)(blob->data() + base + 4);
+        for (u32 i = 0; i < MaxWords; i++) {
+            if (!written[i]) continue;
+            regs->offset = i * 4;
+            regs->value = value[i];
+            regs->kind = kind[i];
+            regs++;
+        }
+    }
+};
+
+struct PatchContext {
+    std::vector<Op>* ops;
+    const u8* arena_base;
+    const MemMap* map;
+};
+
+// Resolves one trace-physical address to its baked (kind, value) form.
+void BakeAddress(const MemMap& map, u32 trace_addr, u32 raw_value, u32 shift, u32* kind,
+                 u32* value) {
+    if (trace_addr >= 0x18000000 && trace_addr < 0x18600000) {
+        *kind = kAbsolute;
+        *value = raw_value;
+        return;
+    }
+
+    s64 offset = map.TraceToArenaOffset(trace_addr);
+    if (offset < 0) {
+        // Address outside any loaded range; leave it alone like the live
+        // translator does.
+        *kind = kAbsolute;
+        *value = raw_value;
+        return;
+    }
+
+    *kind = (shift == 3) ? kArenaShift3 : kArenaRaw;
+    *value = (u32)offset;
+}
+
+void EmitPatch(u32* word, u32 reg_id, void* ctx) {
+    PatchContext* pc = (PatchContext*)ctx;
+
+    u32 kind, value;
+    BakeAddress(*pc->map, *word << 3, *word, 3, &kind, &value);
+    if (kind == kAbsolute)
+        return; // word already correct at replay time
+
+    Op op;
+    op.type = kPatch;
+    op.a = (u32)((const u8*)word - pc->arena_base);
+    op.b = value;
+    op.c = kind;
+    pc->ops->push_back(op);
+}
+
+// Arena offsets and sizes in a baked op come straight from the file; every
+// op that touches the arena is checked against its bounds before any bytes
+// move, and a violation fails the replay so the caller's rebuild-and-retry
+// path takes over.
+bool InArena(u32 offset, u32 size, u32 arena_size) {
+    return offset <= arena_size && size <= arena_size - offset;
+}
+
+// Runs baked ops until the stream reaches `until_offset`. With
+// `memory_only` set, register writes and frame markers are ignored: the
+// pre-pass used to rebuild memory state for a seek. With `stop_after_frame`
+// set, returns right after committing the first frame marker, leaving
+// presentation to the caller (the stepped A/B path).
+bool RunOps(TraceReader& reader, u8* arena, u32 arena_phys, u32 arena_size,
+            u64 until_offset, bool memory_only, u32* frames, bool* aborted,
+            bool stop_after_frame = false) {
+    while (reader.StreamPos() + sizeof(Op) <= until_offset && !*aborted) {
+        const Op* op = (const Op*)reader.FetchStream(sizeof(Op));
+        if (!op) {
+            printf("baked stream truncated at 0x%08llx\n", reader.StreamPos());
+            return false;
+        }
+
+        switch (op->type) {
+        case kRegWrite:
+            if (!memory_only)
+                g_reg_batch.Queue(op->a, ResolveValue(op->b, op->c, arena_phys));
+            break;
+
+        case kMemLoad: {
+            if (!memory_only)
+                g_reg_batch.Flush();
+            u32 size = op->b;
+            if (!InArena(op->a, size, arena_size)) {
+                printf("baked: load outside the arena (0x%lx+%lu)\n", op->a, size);
+                return false;
+            }
+            u8* dest = arena + op->a;
+            // Served straight from the prefetched ring; the payload bytes
+            // were already read ahead with the rest of the stream.
+            if (R_FAILED(reader.ReadStream(dest, size)) ||
+                R_FAILED(reader.SkipStream(PadPayload(size) - size)))
+                return false;
+            MemFlush::NoteDirty(dest, size);
+            break;
+        }
+
+        case kRegRun: {
+            u32 base = op->a;
+            u32 count = op->b;
+            u32 words[kMaxRegRunWords];
+            if (count > kMaxRegRunWords)
+                return false;
+            if (R_FAILED(reader.ReadStream(words, count * 4)) ||
+                R_FAILED(reader.SkipStream(PadPayload(count * 4) - count * 4)))
+                return false;
+            if (!memory_only) {
+                for (u32 r = 0; r < count; r++)
+                    g_reg_batch.Queue(base + r * 4, words[r]);
+            }
+            break;
+        }
+
+        case kMemDelta: {
+            if (!memory_only)
+                g_reg_batch.Flush();
+            static std::vector<u8> scratch;
+            if (!InArena(op->a, op->c, arena_size)) {
+                printf("baked: delta outside the arena (0x%lx+%lu)\n", op->a, op->c);
+                return false;
+            }
+            u8* dest = arena + op->a;
+            u32 enc_size = op->b;
+            // op->b is file-supplied too. The compiler only stores a delta
+            // when it is smaller than the span it encodes, and the padded
+            // payload must fit in the remaining op stream; checked before
+            // the resize, which -fno-exceptions turns into process death
+            // on an absurd allocation.
+            if (enc_size >= op->c || PadPayload(enc_size) > reader.StreamRemaining()) {
+                printf("baked: bad delta size %lu at 0x%08llx\n", enc_size,
+                       reader.StreamPos());
+                return false;
+            }
+            scratch.resize(enc_size);
+            if (R_FAILED(reader.ReadStream(scratch.data(), enc_size)) ||
+                R_FAILED(reader.SkipStream(PadPayload(enc_size) - enc_size)))
+                return false;
+            if (!DecodeDelta(dest, op->c, scratch.data(), enc_size)) {
+                printf("baked: corrupt delta at 0x%08llx\n", reader.StreamPos());
+                return false;
+            }
+            MemFlush::NoteDirty(dest, op->c);
+            break;
+        }
+
+        case kPatch:
+            if (!InArena(op->a, 4, arena_size)) {
+                printf("baked: patch outside the arena (0x%lx)\n", op->a);
+                return false;
+            }
+            *(u32*)(arena + op->a) = ResolveValue(op->b, op->c, arena_phys);
+            break;
+
+        case kFlush:
+            if (!InArena(op->a, op->b, arena_size)) {
+                printf("baked: flush outside the arena (0x%lx+%lu)\n", op->a, op->b);
+                return false;
+            }
+            MemFlush::NoteDirty(arena + op->a, op->b);
+            break;
+
+        case kFrame:
+            if (stop_after_frame) {
+                MemFlush::Commit();
+                g_reg_batch.Flush();
+                (*frames)++;
+                return true;
+            }
+            if (g_reg_batch.Deferred()) {
+                // Fast-forward: the frame was never rendered; just count it.
+                (*frames)++;
+            } else if (!memory_only) {
+                MemFlush::Commit(); // scanout reads memory without a trigger
+                g_reg_batch.Flush();
+                FbVerify::OnFrame();
+                (*frames)++;
+                Journal::OnFrame(*frames);
+                u64 t0 = Bench::Now();
+                Pacing::FrameWait();
+                Bench::Add(Bench::kGpu, t0);
+                Bench::FrameEnd();
+                hidScanInput();
+                if (hidKeysDown() & KEY_START)
+                    *aborted = true;
+            }
+            break;
+
+        default:
+            printf("baked: unknown op type %lu\n", op->type);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Opens a cache and validates it against the source trace and the arena.
+bool OpenCache(const char* ctb_path, u64 source_size, TraceReader* reader, Header* baked,
+               const MemMap& map) {
+    if (R_FAILED(reader->Open(ctb_path)))
+        return false;
+
+    if (R_FAILED(reader->ReadAt(0, baked, sizeof(*baked))) ||
+        baked->magic != Header::ExpectedMagic ||
+        baked->version != Header::ExpectedVersion ||
+        baked->source_size_lo != (u32)source_size ||
+        baked->source_size_hi != (u32)(source_size >> 32) ||
+        baked->arena_bytes > map.BytesTotal()) {
+        reader->Close();
+        return false;
+    }
+    return true;
+}
+
+// Replays a keyframe's register snapshot through the batcher.
+bool RestoreSnapshot(TraceReader& reader, u32 snapshot_offset, u32 arena_phys) {
+    u32 count = 0;
+    if (R_FAILED(reader.ReadAt(snapshot_offset, &count, 4)))
+        return false;
+
+    SnapshotReg regs[128];
+    u64 pos = snapshot_offset + 4;
+    while (count > 0) {
+        u32 chunk = (count < 128) ? count : 128;
+        if (R_FAILED(reader.ReadAt(pos, regs, chunk * sizeof(SnapshotReg))))
+            return false;
+        for (u32 i = 0; i < chunk; i++)
+            g_reg_batch.Queue(regs[i].offset,
+                              ResolveValue(regs[i].value, regs[i].kind, arena_phys));
+        pos += chunk * sizeof(SnapshotReg);
+        count -= chunk;
+    }
+    g_reg_batch.Flush();
+    return true;
+}
+
+} // namespace
+
+// --- cache path -----------------------------------------------------------
+
+void CachePath(const char* trace_path, char* out, u32 out_size) {
+    size_t len = strlen(trace_path);
+    if (len + 5 > out_size)
+        len = out_size - 5;
+    memcpy(out, trace_path, len);
+    out[len] = 0;
+
+    char* dot = strrchr(out, '.');
+    if (dot && strcmp(dot, ".ctf") == 0)
+        strcpy(dot, ".ctb");
+    else
+        strcat(out, ".ctb");
+}
+
+// --- compile --------------------------------------------------------------
+
+bool Compile(TraceReader& reader, const CiTrace::CTHeader& header, const char* ctb_path,
+             MemMap& map) {
+    Writer out;
+    if (!out.Open(ctb_path)) {
+        printf("bake: cannot create %s\n", ctb_path);
+        return false;
+    }
+
+    // The cache is being rewritten; its CRC sidecar no longer applies.
+    {
+        char crc_path[256];
+        snprintf(crc_path, sizeof(crc_path), "%s.crc", ctb_path);
+        FS_Archive sdmc;
+        if (R_SUCCEEDED(FSUSER_OpenArchive(&sdmc, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, "")))) {
+            FSUSER_DeleteFile(sdmc, fsMakePath(PATH_ASCII, crc_path));
+            FSUSER_CloseArchive(sdmc);
+        }
+    }
+
+    Header baked = {};
+    if (!out.Write(&baked, sizeof(baked))) {
+        out.Close(false);
+        return false;
+    }
+
+    u64 stream_bytes = (u64)header.stream_size * sizeof(CiTrace::CTStreamElement);
+    if (R_FAILED(reader.BeginStream(header.stream_offset, stream_bytes))) {
+        out.Close(false);
+        return false;
+    }
+
+    map.Reset();
+
+    u32 op_count = 0;
+    u32 cmdlist_addr = 0; // trace-physical
+    u32 cmdlist_size = 0;
+    u32 dedup_ops = 0;
+    u64 dedup_bytes = 0;
+    bool ok = true;
+
+    // Small ops (patch bursts) are staged here; loads stream through.
+    std::vector<Op> staged;
+
+    // Payload staging and delta scratch for memory updates.
+    std::vector<u8> payload;
+    std::vector<u8> encoded;
+
+    // Pending run of consecutive absolute register writes, folded into one
+    // kRegRun op when it grows past the break-even point.
+    u32 run_base = 0;
+    u32 run_words[kMaxRegRunWords];
+    u32 run_count = 0;
+
+    auto flush_run = [&]() {
+        if (run_count == 0)
+            return;
+        if (run_count >= 3) {
+            Op op = {kRegRun, run_base, run_count, 0};
+            ok = ok && out.Write(&op, sizeof(op)) && out.Write(run_words, run_count * 4);
+            u32 pad = PadPayload(run_count * 4) - run_count * 4;
+            if (pad) {
+                static const u8 zeros[16] = {};
+                ok = ok && out.Write(zeros, pad);
+            }
+            op_count++;
+        } else {
+            for (u32 r = 0; r < run_count; r++) {
+                Op op = {kRegWrite, run_base + r * 4, run_words[r], kAbsolute};
+                ok = ok && out.Write(&op, sizeof(op));
+                op_count++;
+            }
+        }
+        run_count = 0;
+    };
+
+    // Per-frame index plus keyframe register snapshots, written after the
+    // ops. snapshot_offset holds a blob-relative offset until then.
+    std::vector<IndexEntry> index;
+    std::vector<u8> snapshots;
+    static RegShadow shadow;
+    shadow.Reset();
+
+    IndexEntry first = {(u32)out.Position(), 0, 0, 0};
+    shadow.Emit(&snapshots); // frame 0 keyframe: the empty register file
+    index.push_back(first);
+
+    for (u32 i = 0; i < header.stream_size && ok; i++) {
+        const auto* element =
+            (const CiTrace::CTStreamElement*)reader.FetchStream(sizeof(CiTrace::CTStreamElement));
+        if (!element) {
+            printf("bake: stream truncated at element %lu\n", i);
+            ok = false;
+            break;
+        }
+
+        switch (element->type) {
+        case CiTrace::FrameMarker: {
+            flush_run();
+            Op op = {kFrame, 0, 0, 0};
+            ok = ok && out.Write(&op, sizeof(op));
+            op_count++;
+
+            IndexEntry entry;
+            entry.file_offset = (u32)out.Position();
+            entry.op_index = op_count;
+            entry.pad = 0;
+            if (index.size() % kKeyframeInterval == 0) {
+                entry.snapshot_offset = (u32)snapshots.size();
+                shadow.Emit(&snapshots);
+            } else {
+                entry.snapshot_offset = 0xFFFFFFFF;
+            }
+            index.push_back(entry);
+            break;
+        }
+
+        case CiTrace::MemoryLoad: {
+            flush_run();
+
+            const auto& load = element->memory_load;
+            bool fresh = false;
+            u8* dest = map.Place(load.physical_address, load.size, &fresh);
+            if (!dest) {
+                printf("bake: no arena home for 0x%08lx+%lu\n", load.physical_address,
+                       load.size);
+                ok = false;
+                break;
+            }
+
+            payload.resize(load.size);
+            if (R_FAILED(reader.ReadAt(load.file_offset, payload.data(), load.size))) {
+                ok = false;
+                break;
+            }
+
+            // Titles re-upload the same textures and vertex buffers over
+            // and over; a payload identical to what is already resident at
+            // the target gets no op at all, so replay never copies or
+            // flushes it. memcmp beats hashing here: both buffers are in
+            // RAM and it bails on the first differing byte.
+            if (!fresh && memcmp(dest, payload.data(), load.size) == 0) {
+                dedup_ops++;
+                dedup_bytes += load.size;
+                break;
+            }
+
+            // A re-upload of a range we hold the previous contents of is
+            // stored as a delta when that actually saves bytes.
+            s32 enc_size = -1;
+            if (!fresh) {
+                encoded.resize(load.size);
+                enc_size = EncodeDelta(dest, payload.data(), load.size, encoded.data(),
+                                       load.size);
+            }
+
+            Op op;
+            op.a = (u32)(dest - map.ArenaBase());
+            const u8* body;
+            u32 body_size;
+            if (enc_size >= 0) {
+                op.type = kMemDelta;
+                op.b = (u32)enc_size;
+                op.c = load.size;
+                body = encoded.data();
+                body_size = (u32)enc_size;
+            } else {
+                op.type = kMemLoad;
+                op.b = load.size;
+                op.c = 0;
+                body = payload.data();
+                body_size = load.size;
+            }
+
+            memcpy(dest, payload.data(), load.size);
+
+            ok = ok && out.Write(&op, sizeof(op)) && out.Write(body, body_size);
+            op_count++;
+
+            u32 pad = PadPayload(body_size) - body_size;
+            if (ok && pad) {
+                static const u8 zeros[16] = {};
+                ok = out.Write(zeros, pad);
+            }
+            break;
+        }
+
+        case CiTrace::RegisterWrite: {
+            const auto& w = element->register_write;
+            u32 addr = w.physical_address;
+
+            if (addr >= 0x10202000 && addr < 0x10203000)
+                break; // LCD, skipped like the live path
+            if (addr < 0x10400000 || addr >= 0x10500000)
+                break;
+
+            u32 offset = addr - 0x10400000;
+            u32 parts = (w.size == CiTrace::CTRegisterWrite::SIZE_64) ? 2 : 1;
+
+            for (u32 p = 0; p < parts && ok; p++) {
+                u32 part_offset = offset + p * 4;
+                u32 raw = (u32)(w.value >> (32 * p));
+
+                if (part_offset == 0x18E0)
+                    cmdlist_size = raw << 3;
+                if (part_offset == 0x18E8)
+                    cmdlist_addr = raw << 3;
+
+                // The trigger write is where the live path walks the list;
+                // here the walk happens once, emitting patch + flush ops.
+                if (part_offset == 0x18F0 && cmdlist_addr) {
+                    flush_run();
+                    s64 list_off = map.TraceToArenaOffset(cmdlist_addr);
+                    if (list_off >= 0) {
+                        staged.clear();
+                        PatchContext pc = {&staged, map.ArenaBase(), &map};
+                        WalkCommandListAddresses(
+                            (u32*)(map.ArenaBase() + list_off), cmdlist_size / 4,
+                            EmitPatch, &pc);
+
+                        for (const Op& patch : staged) {
+                            ok = ok && out.Write(&patch, sizeof(patch));
+                            op_count++;
+                        }
+                        if (!staged.empty()) {
+                            Op flush = {kFlush, (u32)list_off, cmdlist_size, 0};
+                            ok = ok && out.Write(&flush, sizeof(flush));
+                            op_count++;
+                        }
+                    }
+                }
+
+                Op op;
+                op.type = kRegWrite;
+                op.a = part_offset;
+
+                int shift = ExternalRegAddrShift(part_offset);
+                if (shift >= 0) {
+                    BakeAddress(map, raw << shift, raw, (u32)shift, &op.c, &op.b);
+                } else {
+                    op.b = raw;
+                    op.c = kAbsolute;
+                }
+
+                shadow.Note(op.a, op.b, op.c);
+
+                // Absolute-valued writes to ascending consecutive words
+                // collapse into a kRegRun; anything else breaks the run.
+                if (op.c == kAbsolute) {
+                    if (run_count > 0 &&
+                        (op.a != run_base + run_count * 4 || run_count == kMaxRegRunWords))
+                        flush_run();
+                    if (run_count == 0)
+                        run_base = op.a;
+                    run_words[run_count++] = op.b;
+                } else {
+                    flush_run();
+                    ok = ok && out.Write(&op, sizeof(op));
+                    op_count++;
+                }
+            }
+            break;
+        }
+
+        default:
+            printf("bake: unknown element type 0x%lx at %lu\n", (u32)element->type, i);
+            ok = false;
+            break;
+        }
+    }
+
+    flush_run();
+
+    u32 frame_count = (u32)index.size() - 1;
+
+    if (ok) {
+        // Trailing index entries reference nothing past the last frame.
+        index.resize(frame_count ? frame_count : 1);
+
+        u32 blob_base = (u32)out.Position();
+        baked.ops_end = blob_base;
+        ok = out.Write(snapshots.data(), (u32)snapshots.size());
+
+        for (auto& entry : index)
+            entry.snapshot_offset =
+                (entry.snapshot_offset == 0xFFFFFFFF) ? 0 : blob_base + entry.snapshot_offset;
+
+        baked.index_offset = (u32)out.Position();
+        ok = ok && out.Write(index.data(), (u32)(index.size() * sizeof(IndexEntry)));
+    }
+
+    if (ok) {
+        baked.magic = Header::ExpectedMagic;
+        baked.version = Header::ExpectedVersion;
+        baked.source_size_lo = (u32)reader.FileSize();
+        baked.source_size_hi = (u32)(reader.FileSize() >> 32);
+        baked.arena_bytes = map.BytesUsed();
+        baked.op_count = op_count;
+        baked.frame_count = frame_count;
+        baked.keyframe_interval = kKeyframeInterval;
+        ok = out.WriteAt(0, &baked, sizeof(baked));
+    }
+
+    out.Close(ok);
+    printf("bake: %s (%lu ops, %lu frames)\n", ok ? "ok" : "failed", op_count, frame_count);
+    if (ok && dedup_ops)
+        printf("bake: dropped %lu duplicate uploads (%llu bytes)\n", dedup_ops, dedup_bytes);
+    return ok;
+}
+
+// --- replay ---------------------------------------------------------------
+
+bool Replay(const char* ctb_path, u64 source_size, u32 start_frame, u32* frames,
+            bool* aborted, MemMap& map) {
+    *frames = 0;
+    *aborted = false;
+
+    TraceReader reader;
+    Header baked;
+    if (!OpenCache(ctb_path, source_size, &reader, &baked, map))
+        return false;
+
+    map.Reset();
+
+    u8* arena = map.ArenaBase();
+    u32 arena_phys = map.ArenaPhys();
+    u32 arena_size = map.BytesTotal();
+    u64 ops_end = baked.ops_end;
+
+    u64 begin_offset = sizeof(Header);
+
+    if (start_frame >= baked.frame_count)
+        start_frame = 0;
+
+    bool ok = true;
+
+    if (start_frame > 0 && baked.keyframe_interval) {
+        u32 keyframe = start_frame - (start_frame % baked.keyframe_interval);
+
+        IndexEntry entry, target;
+        if (R_FAILED(reader.ReadAt(baked.index_offset + keyframe * sizeof(IndexEntry),
+                                   &entry, sizeof(entry))) ||
+            entry.snapshot_offset == 0 ||
+            R_FAILED(reader.ReadAt(baked.index_offset + start_frame * sizeof(IndexEntry),
+                                   &target, sizeof(target)))) {
+            reader.Close();
+            return false;
+        }
+
+        // Rebuild memory state up to the keyframe without touching the GPU
+        // register file; this is decode- and SD-bound, no rendering.
+        if (R_FAILED(reader.BeginStream(sizeof(Header), ops_end - sizeof(Header))) ||
+            !RunOps(reader, arena, arena_phys, arena_size, entry.file_offset, true, frames,
+                    aborted)) {
+            reader.Close();
+            return false;
+        }
+
+        *frames = keyframe;
+        begin_offset = entry.file_offset;
+
+        // Snapshot and the frames between keyframe and target accumulate in
+        // the shadow only; one SubmitShadow burst then resumes the GPU at
+        // the target frame, so the skipped frames are never rendered.
+        g_reg_batch.SetDeferred(true);
+        ok = RestoreSnapshot(reader, entry.snapshot_offset, arena_phys) &&
+             R_SUCCEEDED(reader.BeginStream(begin_offset, ops_end - begin_offset)) &&
+             RunOps(reader, arena, arena_phys, arena_size, target.file_offset, false, frames,
+                    aborted);
+        g_reg_batch.SetDeferred(false);
+        g_reg_batch.SubmitShadow();
+
+        ok = ok && RunOps(reader, arena, arena_phys, arena_size, ops_end, false, frames,
+                          aborted);
+    } else {
+        ok = R_SUCCEEDED(reader.BeginStream(begin_offset, ops_end - begin_offset)) &&
+             RunOps(reader, arena, arena_phys, arena_size, ops_end, false, frames, aborted);
+    }
+
+    g_reg_batch.Flush();
+
+    // Full sequential runs settle the cache's stream CRC, hashed behind
+    // playback by the prefetcher. A mismatch fails the replay, and the
+    // caller's rebuild-and-retry path is exactly the right remedy.
+    if (ok && !*aborted && begin_offset == sizeof(Header))
+        ok = TraceCheck::FinishCrc(ctb_path, reader);
+
+    reader.Close();
+    return ok;
+}
+
+// --- hold frame -----------------------------------------------------------
+
+bool HoldFrame(const char* ctb_path, u64 source_size, u32 frame, bool* aborted, MemMap& map) {
+    *aborted = false;
+
+    TraceReader reader;
+    Header baked;
+    if (!OpenCache(ctb_path, source_size, &reader, &baked, map))
+        return false;
+
+    if (baked.frame_count == 0) {
+        reader.Close();
+        return false;
+    }
+    if (frame >= baked.frame_count)
+        frame = baked.frame_count - 1;
+
+    map.Reset();
+
+    u8* arena = map.ArenaBase();
+    u32 arena_phys = map.ArenaPhys();
+    u32 arena_size = map.BytesTotal();
+    u64 ops_end = baked.ops_end;
+
+    // Frame boundaries from the index: the target frame's ops span
+    // [target.file_offset, frame_end), kFrame op included.
+    IndexEntry target;
+    if (R_FAILED(reader.ReadAt(baked.index_offset + frame * sizeof(IndexEntry), &target,
+                               sizeof(target)))) {
+        reader.Close();
+        return false;
+    }
+    u64 frame_end = ops_end;
+    if (frame + 1 < baked.frame_count) {
+        IndexEntry next;
+        if (R_FAILED(reader.ReadAt(baked.index_offset + (frame + 1) * sizeof(IndexEntry),
+                                   &next, sizeof(next)))) {
+            reader.Close();
+            return false;
+        }
+        frame_end = next.file_offset;
+    }
+
+    // Reach the pre-frame state the usual way: memory pre-pass to the
+    // nearest keyframe, snapshot restore, then render up to the target.
+    u32 keyframe = frame - (frame % baked.keyframe_interval);
+    IndexEntry key;
+    if (R_FAILED(reader.ReadAt(baked.index_offset + keyframe * sizeof(IndexEntry), &key,
+                               sizeof(key))) ||
+        key.snapshot_offset == 0) {
+        reader.Close();
+        return false;
+    }
+
+    u32 approach_frames = 0;
+    if (R_FAILED(reader.BeginStream(sizeof(Header), ops_end - sizeof(Header))) ||
+        !RunOps(reader, arena, arena_phys, arena_size, key.file_offset, true,
+                &approach_frames, aborted) ||
+        !RestoreSnapshot(reader, key.snapshot_offset, arena_phys) ||
+        R_FAILED(reader.BeginStream(key.file_offset, target.file_offset - key.file_offset)) ||
+        !RunOps(reader, arena, arena_phys, arena_size, target.file_offset, false,
+                &approach_frames, aborted)) {
+        reader.Close();
+        return false;
+    }
+
+    // Collect the memory extents the frame writes (one dry scan), then save
+    // their pre-frame contents so every iteration can rewind them.
+    struct SaveExtent {
+        u32 offset;
+        u32 size;
+    };
+    std::vector<SaveExtent> extents;
+    u64 save_bytes = 0;
+
+    if (R_FAILED(reader.BeginStream(target.file_offset, frame_end - target.file_offset))) {
+        reader.Close();
+        return false;
+    }
+    while (reader.StreamPos() + sizeof(Op) <= frame_end) {
+        const Op* op = (const Op*)reader.FetchStream(sizeof(Op));
+        if (!op) {
+            reader.Close();
+            return false;
+        }
+        switch (op->type) {
+        case kMemLoad:
+            extents.push_back({op->a, op->b});
+            reader.SkipStream(PadPayload(op->b));
+            break;
+        case kMemDelta:
+            extents.push_back({op->a, op->c});
+            reader.SkipStream(PadPayload(op->b));
+            break;
+        case kPatch:
+            extents.push_back({op->a, 4});
+            break;
+        case kRegRun:
+            reader.SkipStream(PadPayload(op->b * 4));
+            break;
+        default:
+            break;
+        }
+    }
+    for (const SaveExtent& e : extents) {
+        // The save/rewind memcpys below trust these spans, so they get the
+        // same validation RunOps applies.
+        if (!InArena(e.offset, e.size, arena_size)) {
+            printf("hold: extent outside the arena (0x%lx+%lu)\n", e.offset, e.size);
+            reader.Close();
+            return false;
+        }
+        save_bytes += e.size;
+    }
+
+    u8* save = nullptr;
+    if (save_bytes > 0) {
+        save = (u8*)malloc(save_bytes);
+        if (!save) {
+            printf("hold: no memory for %llu-byte frame snapshot\n", save_bytes);
+            reader.Close();
+            return false;
+        }
+        u8* p = save;
+        for (const SaveExtent& e : extents) {
+            memcpy(p, arena + e.offset, e.size);
+            p += e.size;
+        }
+    }
+
+    // Pre-frame register file, from the batcher's shadow.
+    std::vector<u32> reg_vals(g_reg_batch.ShadowValues(),
+                              g_reg_batch.ShadowValues() + RegBatch::ShadowWords);
+    std::vector<u8> reg_valid(g_reg_batch.ShadowValid(),
+                              g_reg_batch.ShadowValid() + RegBatch::ShadowWords);
+
+    printf("holding frame %lu (%u extents, %llu bytes); START exits\n", frame,
+           extents.size(), save_bytes);
+
+    u32 iterations = 0;
+    bool ok = true;
+    while (!*aborted && ok) {
+        ok = R_SUCCEEDED(reader.BeginStream(target.file_offset,
+                                            frame_end - target.file_offset)) &&
+             RunOps(reader, arena, arena_phys, arena_size, frame_end, false, &iterations,
+                    aborted);
+
+        // Rewind everything the frame touched: memory first, then every
+        // register whose shadow no longer matches the snapshot.
+        u8* p = save;
+        for (const SaveExtent& e : extents) {
+            memcpy(arena + e.offset, p, e.size);
+            MemFlush::NoteDirty(arena + e.offset, e.size);
+            p += e.size;
+        }
+
+        const u32* cur_vals = g_reg_batch.ShadowValues();
+        const u8* cur_valid = g_reg_batch.ShadowValid();
+        for (u32 i = 0; i < RegBatch::ShadowWords; i++) {
+            if (reg_valid[i] && (!cur_valid[i] || cur_vals[i] != reg_vals[i]))
+                g_reg_batch.Queue(i * 4, reg_vals[i]);
+        }
+        g_reg_batch.Flush();
+    }
+
+    printf("held frame %lu for %lu iterations\n", frame, iterations);
+
+    free(save);
+    reader.Close();
+    return ok;
+}
+
+// --- stepped replay -------------------------------------------------------
+
+bool Stepper::Open(const char* ctb_path, u64 source_size, MemMap& map) {
+    if (!OpenCache(ctb_path, source_size, &reader, &baked, map))
+        return false;
+
+    map.Reset();
+    arena = map.ArenaBase();
+    arena_phys = map.ArenaPhys();
+    arena_size = map.BytesTotal();
+    frame = 0;
+    failed = false;
+
+    if (R_FAILED(reader.BeginStream(sizeof(Header), baked.ops_end - sizeof(Header)))) {
+        reader.Close();
+        return false;
+    }
+    return true;
+}
+
+bool Stepper::Step() {
+    if (failed || frame >= baked.frame_count)
+        return false;
+
+    u32 before = frame;
+    bool aborted = false;
+    if (!RunOps(reader, arena, arena_phys, arena_size, baked.ops_end, false, &frame, &aborted,
+                true)) {
+        failed = true;
+        return false;
+    }
+    // No frame marker before the stream ran out: the trace is done.
+    return frame > before;
+}
+
+void Stepper::Close() {
+    reader.Close();
+}
+
+} // namespace Baked
@@ -0,0 +1,141 @@
+// Baked trace cache (.ctb).
+//
+// A baked trace is the stream section compiled down to flat replay ops:
+// register writes with addresses already resolved to arena-relative form,
+// memory loads with their payloads inlined in stream order, and patch ops
+// replacing the command-list fixup walk. Replaying one is a single
+// sequential read with no parsing, no address translation and no scattered
+// payload seeks; the cache lives next to the .ctf on SD and is rebuilt
+// whenever the source file changes size.
+
+#pragma once
+
+#include <3ds.h>
+
+#include "citrace.h"
+#include "trace_reader.h"
+
+class MemMap;
+
+namespace Baked {
+
+struct Header {
+    static const u32 ExpectedMagic = 0x6B625443; // "CTbk"
+    static const u32 ExpectedVersion = 4;
+
+    u32 magic;
+    u32 version;
+    u32 source_size_lo; // size of the source .ctf, staleness check
+    u32 source_size_hi;
+    u32 arena_bytes; // high-water arena usage of the compiled stream
+    u32 op_count;
+    u32 frame_count;
+    u32 index_offset;      // frame index section, at the end of the file
+    u32 keyframe_interval; // register snapshot every this many frames
+    u32 ops_end;           // end of the op region; snapshots follow it
+    u32 reserved[2];
+};
+
+// One per frame, at index_offset: where in the file the frame's ops start,
+// and (for keyframes) where its register snapshot lives.
+struct IndexEntry {
+    u32 file_offset;
+    u32 op_index;
+    u32 snapshot_offset; // 0: not a keyframe
+    u32 pad;
+};
+
+// A snapshot is a count followed by that many entries: every external
+// register written so far, in baked (value, kind) form so it rebases like
+// any other op.
+struct SnapshotReg {
+    u32 offset;
+    u32 value;
+    u32 kind;
+};
+
+enum OpType : u32 {
+    kRegWrite = 1, // a = external reg offset, b/c = value (see ValueKind)
+    kMemLoad = 2,  // a = arena offset, b = size; payload follows inline
+    kPatch = 3,    // a = arena byte offset of word, b/c = value
+    kFlush = 4,    // a = arena offset, b = size
+    kFrame = 5,
+    kRegRun = 6,   // a = first reg offset, b = word count; words follow inline
+    kMemDelta = 7, // a = arena offset, b = encoded size, c = original size;
+                   // skip/copy delta (see delta.h) follows inline
+};
+
+// Longest kRegRun; matches the batcher's gsp transfer cap so a replayed
+// run feeds exactly one WriteHWRegs submission.
+static const u32 kMaxRegRunWords = 32;
+
+// How a baked value is turned into the word the GPU sees at replay time.
+enum ValueKind : u32 {
+    kAbsolute = 0,    // value used as-is (plain data, VRAM addresses)
+    kArenaShift3 = 1, // (arena physical base + value) >> 3
+    kArenaRaw = 2,    // arena physical base + value
+};
+
+struct Op {
+    u32 type;
+    u32 a;
+    u32 b;
+    u32 c;
+};
+
+// Derives the cache path for a trace ("/foo.ctf" -> "/foo.ctb").
+void CachePath(const char* trace_path, char* out, u32 out_size);
+
+// Compiles the stream section of an open trace into `ctb_path`. Uses (and
+// fills) `map`; call MemMap::Reset before replaying.
+bool Compile(TraceReader& reader, const CiTrace::CTHeader& header, const char* ctb_path,
+             MemMap& map);
+
+// Replays a baked trace, optionally starting at `start_frame`: memory state
+// is rebuilt with a register-free pre-pass up to the nearest keyframe, then
+// the keyframe snapshot and the frames up to the target accumulate in the
+// register shadow and are submitted as one burst - nothing before the
+// target frame is rendered. Returns false if the cache is missing, stale or damaged
+// (caller falls back to live replay). `frames`/`aborted` report the outcome
+// as the live loop does.
+bool Replay(const char* ctb_path, u64 source_size, u32 start_frame, u32* frames,
+            bool* aborted, MemMap& map);
+
+// Replays up to `frame`, snapshots the pre-frame state (the batcher's
+// register shadow plus the memory extents the frame writes), then re-runs
+// that single frame in a loop from the snapshot until START is pressed.
+// Sub-second iteration on a suspect frame, and a soak test for single-frame
+// determinism. Needs a valid cache; returns false like Replay if there
+// isn't one.
+bool HoldFrame(const char* ctb_path, u64 source_size, u32 frame, bool* aborted, MemMap& map);
+
+// Frame-stepped replay, for running two traces in lockstep (A/B mode).
+// Each Step replays one frame's ops through the usual batching paths and
+// commits them, but leaves presentation pacing to the caller, who
+// interleaves steps from both instances under one VBlank wait.
+class Stepper {
+public:
+    // Opens and validates a cache against `map`, which must stay alive and
+    // untouched by others until Close. Same staleness rules as Replay.
+    bool Open(const char* ctb_path, u64 source_size, MemMap& map);
+    void Close();
+
+    // Replays the next frame. Returns false at the end of the trace or on
+    // a stream error (see Failed).
+    bool Step();
+
+    bool Failed() const { return failed; }
+    u32 Frame() const { return frame; }
+    u32 FrameCount() const { return baked.frame_count; }
+
+private:
+    TraceReader reader;
+    Header baked = {};
+    u8* arena = nullptr;
+    u32 arena_phys = 0;
+    u32 arena_size = 0;
+    u32 frame = 0;
+    bool failed = false;
+};
+
+} // namespace Baked
@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "bench.h"
+
+namespace Bench {
+
+namespace {
+
+u32 TicksToUs(u64 ticks) {
+    return (u32)(ticks * 1000000 / kTicksPerSecond);
+}
+
+struct FrameSample {
+    u16 iteration;
+    u16 pad;
+    u32 frame;
+    u32 stage_us[kStageCount];
+    u32 total_us;
+};
+
+bool active = false;
+u32 iteration = 0;
+u32 frame_in_iteration = 0;
+u64 frame_start = 0;
+u64 stage_ticks[kStageCount];
+u64 run_ticks[kStageCount];
+std::vector<FrameSample> samples;
+
+// kRead is fed from the prefetch thread as well as the replay thread, so
+// it bypasses the plain tick arrays (a u64 read-modify-write would tear on
+// this core pair) and accumulates in one atomic microsecond counter. The
+// replay thread derives per-frame and per-run figures by differencing it.
+u32 read_us_total = 0;
+u32 frame_read_base = 0;
+u32 run_read_base = 0;
+
+void PrintLine(const char* name, std::vector<u32>& column) {
+    if (column.empty())
+        return;
+    std::sort(column.begin(), column.end());
+    u64 sum = 0;
+    for (u32 v : column)
+        sum += v;
+    u32 p99 = column[(column.size() * 99) / 100];
+    printf("%-8s min %6lu avg %6lu p99 %6lu us\n", name, column.front(),
+           (u32)(sum / column.size()), p99);
+}
+
+} // namespace
+
+bool Active() {
+    return active;
+}
+
+void StartRun(u32 iterations) {
+    active = true;
+    samples.clear();
+    samples.reserve(1024 * iterations);
+}
+
+void BeginIteration(u32 index) {
+    iteration = index;
+    frame_in_iteration = 0;
+    memset(stage_ticks, 0, sizeof(stage_ticks));
+    frame_read_base = __atomic_load_n(&read_us_total, __ATOMIC_RELAXED);
+    frame_start = Now();
+}
+
+void Add(Stage stage, u64 t0) {
+    u64 delta = Now() - t0;
+    if (stage == kRead) {
+        __atomic_fetch_add(&read_us_total, TicksToUs(delta), __ATOMIC_RELAXED);
+        return;
+    }
+    run_ticks[stage] += delta;
+    if (!active)
+        return;
+    stage_ticks[stage] += delta;
+}
+
+void ResetRun() {
+    memset(run_ticks, 0, sizeof(run_ticks));
+    run_read_base = __atomic_load_n(&read_us_total, __ATOMIC_RELAXED);
+}
+
+u32 RunStageUs(Stage stage) {
+    if (stage == kRead)
+        return __atomic_load_n(&read_us_total, __ATOMIC_RELAXED) - run_read_base;
+    return TicksToUs(run_ticks[stage]);
+}
+
+void FrameEnd() {
+    if (!active)
+        return;
+
+    u64 now = Now();
+
+    FrameSample s;
+    s.iteration = (u16)iteration;
+    s.pad = 0;
+    s.frame = frame_in_iteration++;
+    for (u32 i = 0; i < kStageCount; i++)
+        s.stage_us[i] = TicksToUs(stage_ticks[i]);
+
+    u32 read_now = __atomic_load_n(&read_us_total, __ATOMIC_RELAXED);
+    s.stage_us[kRead] = read_now - frame_read_base;
+    frame_read_base = read_now;
+
+    s.total_us = TicksToUs(now - frame_start);
+    samples.push_back(s);
+
+    memset(stage_ticks, 0, sizeof(stage_ticks));
+    frame_start = now;
+}
+
+void Report(const char* trace_path) {
+    if (samples.empty()) {
+        printf("bench: no samples\n");
+        return;
+    }
+
+    static const char* kStageNames[kStageCount] = {"read", "upload", "submit", "gpu"};
+
+    std::vector<u32> column(samples.size());
+
+    printf("bench: %u frame samples\n", samples.size());
+    for (u32 st = 0; st < kStageCount; st++) {
+        for (size_t i = 0; i < samples.size(); i++)
+            column[i] = samples[i].stage_us[st];
+        PrintLine(kStageNames[st], column);
+    }
+
+    // Decode and everything else not explicitly measured.
+    for (size_t i = 0; i < samples.size(); i++) {
+        u32 measured = 0;
+        for (u32 st = 0; st < kStageCount; st++)
+            measured += samples[i].stage_us[st];
+        column[i] = (samples[i].total_us > measured) ? samples[i].total_us - measured : 0;
+    }
+    PrintLine("decode", column);
+
+    for (size_t i = 0; i < samples.size(); i++)
+        column[i] = samples[i].total_us;
+    PrintLine("total", column);
+
+    // CSV next to the trace: one row per frame per iteration.
+    char csv_path[256];
+    snprintf(csv_path, sizeof(csv_path), "%s.bench.csv", trace_path);
+
+    FS_Archive sdmc;
+    if (R_FAILED(FSUSER_OpenArchive(&sdmc, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""))))
+        return;
+
+    Handle file;
+    FSUSER_DeleteFile(sdmc, fsMakePath(PATH_ASCII, csv_path));
+    if (R_SUCCEEDED(FSUSER_OpenFile(&file, sdmc, fsMakePath(PATH_ASCII, csv_path),
+                                    FS_OPEN_WRITE | FS_OPEN_CREATE, 0))) {
+        char line[128];
+        u64 pos = 0;
+        u32 written = 0;
+
+        int n = snprintf(line, sizeof(line), "iter,frame,read,upload,submit,gpu,decode,total\n");
+        FSFILE_Write(file, &written, pos, line, n, 0);
+        pos += n;
+
+        for (const auto& s : samples) {
+            u32 measured = 0;
+            for (u32 st = 0; st < kStageCount; st++)
+                measured += s.stage_us[st];
+            u32 decode = (s.total_us > measured) ? s.total_us - measured : 0;
+
+            n = snprintf(line, sizeof(line), "%u,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n",
+                         s.iteration, s.frame, s.stage_us[kRead], s.stage_us[kUpload],
+                         s.stage_us[kSubmit], s.stage_us[kGpu], decode, s.total_us);
+            FSFILE_Write(file, &written, pos, line, n, 0);
+            pos += n;
+        }
+
+        FSFILE_Close(file);
+        printf("bench: wrote %s\n", csv_path);
+    }
+
+    FSUSER_CloseArchive(sdmc);
+}
+
+} // namespace Bench
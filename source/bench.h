@@ -0,0 +1,52 @@
+// Replay benchmark mode.
+//
+// When active, the reader, the upload path, the submission batcher and the
+// frame loop feed per-stage tick counts into a per-frame sample buffer.
+// Decode/translation cost is not instrumented directly; it is reported as
+// the residual of the frame total minus the measured stages. Results are
+// printed as min/avg/p99 per stage and dumped as CSV to SD for the farm to
+// diff across builds.
+
+#pragma once
+
+#include <3ds.h>
+
+namespace Bench {
+
+enum Stage {
+    kRead = 0,   // SD I/O: window refills and positioned reads
+    kUpload,     // memory-update cache flushes
+    kSubmit,     // gsp register submission
+    kGpu,        // VBlank wait: GPU execution + LCD
+    kStageCount,
+};
+
+bool Active();
+
+// Starts collection for `iterations` replays of the same trace.
+void StartRun(u32 iterations);
+void BeginIteration(u32 index);
+
+// Accounts the time since `t0` (svcGetSystemTick) to a stage. kRead may be
+// fed from the prefetch thread; the other stages are replay-thread only.
+void Add(Stage stage, u64 t0);
+
+// Whole-run stage totals, kept even outside benchmark mode; the stats
+// ledger records them per replay. Reset at the start of every replay.
+void ResetRun();
+u32 RunStageUs(Stage stage);
+
+// Closes the current frame sample.
+void FrameEnd();
+
+// Prints the summary and writes the per-frame CSV next to the trace.
+void Report(const char* trace_path);
+
+// ARM11 system tick rate.
+const u64 kTicksPerSecond = 268123480;
+
+inline u64 Now() {
+    return svcGetSystemTick();
+}
+
+} // namespace Bench
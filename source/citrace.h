@@ -0,0 +1,87 @@
+// CiTrace (.ctf) file format definitions.
+//
+// Mirrors the structures Citra writes in src/core/tracer/citrace.h. All
+// offsets in the header are byte offsets from the start of the file; section
+// sizes are given in 32-bit words. The stream section is a flat array of
+// CTStreamElement records.
+
+#pragma once
+
+#include <3ds/types.h>
+
+namespace CiTrace {
+
+struct CTHeader {
+    static const char* ExpectedMagicWord() { return "CiTr"; }
+    static u32 ExpectedVersion() { return 1; }
+
+    char magic[4];
+    u32 version;
+    u32 header_size;
+
+    struct {
+        // NOTE: Register range sizes are hardware constants whose exact
+        // limits aren't known, hence the presumed sizes are stored along
+        // with the offsets. Sizes are in u32 units.
+        u32 gpu_registers;
+        u32 gpu_registers_size;
+        u32 lcd_registers;
+        u32 lcd_registers_size;
+        u32 pica_registers;
+        u32 pica_registers_size;
+        u32 default_attributes;
+        u32 default_attributes_size;
+        u32 vs_program_binary;
+        u32 vs_program_binary_size;
+        u32 vs_swizzle_data;
+        u32 vs_swizzle_data_size;
+        u32 vs_float_uniforms;
+        u32 vs_float_uniforms_size;
+        u32 gs_program_binary;
+        u32 gs_program_binary_size;
+        u32 gs_swizzle_data;
+        u32 gs_swizzle_data_size;
+        u32 gs_float_uniforms;
+        u32 gs_float_uniforms_size;
+    } initial_state_offsets;
+
+    u32 stream_offset;
+    u32 stream_size; // number of CTStreamElement records
+};
+
+enum CTStreamElementType : u32 {
+    FrameMarker   = 0xE1,
+    MemoryLoad    = 0xE2,
+    RegisterWrite = 0xE3,
+};
+
+struct CTMemoryLoad {
+    u32 file_offset; // payload location, outside the stream section
+    u32 size;
+    u32 physical_address;
+    u32 pad;
+};
+
+struct CTRegisterWrite {
+    u32 physical_address;
+
+    enum Size : u32 {
+        SIZE_8  = 0xD1,
+        SIZE_16 = 0xD2,
+        SIZE_32 = 0xD3,
+        SIZE_64 = 0xD4,
+    } size;
+
+    u64 value;
+};
+
+struct CTStreamElement {
+    CTStreamElementType type;
+
+    union {
+        CTMemoryLoad memory_load;
+        CTRegisterWrite register_write;
+    };
+};
+
+} // namespace CiTrace
@@ -0,0 +1,24 @@
+#include "crc32.h"
+
+namespace {
+
+// 4-bit slices of the reflected 0xEDB88320 polynomial.
+const u32 kNibbleTable[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+} // namespace
+
+u32 Crc32Update(u32 crc, const void* data, u32 size) {
+    const u8* p = (const u8*)data;
+    crc = ~crc;
+    while (size--) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ kNibbleTable[crc & 0xF];
+        crc = (crc >> 4) ^ kNibbleTable[crc & 0xF];
+    }
+    return ~crc;
+}
@@ -0,0 +1,11 @@
+// Incremental CRC32 (IEEE, reflected polynomial).
+//
+// Nibble-table variant: the whole table is 64 bytes, so it stays in L1
+// while the prefetch thread interleaves hashing with SD reads. Start from
+// 0 and chain calls over consecutive blocks.
+
+#pragma once
+
+#include <3ds/types.h>
+
+u32 Crc32Update(u32 crc, const void* data, u32 size);
@@ -0,0 +1,67 @@
+#include <cstring>
+
+#include "delta.h"
+
+// A run of at least this many unchanged bytes ends a literal span; shorter
+// runs aren't worth a record's 8-byte header.
+static const u32 kMinSkipRun = 16;
+
+s32 EncodeDelta(const u8* prev, const u8* next, u32 size, u8* out, u32 cap) {
+    u32 pos = 0;
+    u32 out_pos = 0;
+
+    while (pos < size) {
+        u32 skip_start = pos;
+        while (pos < size && prev[pos] == next[pos])
+            pos++;
+        u32 skip = pos - skip_start;
+
+        // Extend the literal until a long-enough unchanged run (or the end),
+        // then back the trailing unchanged bytes out of it.
+        u32 lit_start = pos;
+        u32 equal = 0;
+        while (pos < size && equal < kMinSkipRun) {
+            equal = (prev[pos] == next[pos]) ? equal + 1 : 0;
+            pos++;
+        }
+        u32 lit_end = pos - equal;
+        u32 copy = lit_end - lit_start;
+
+        if (copy == 0)
+            break; // nothing changed through to the end
+
+        if (out_pos + 8 + copy >= cap)
+            return -1;
+
+        memcpy(out + out_pos, &skip, 4);
+        memcpy(out + out_pos + 4, &copy, 4);
+        memcpy(out + out_pos + 8, next + lit_start, copy);
+        out_pos += 8 + copy;
+
+        pos = lit_end; // the unchanged tail joins the next record's skip
+    }
+
+    return (s32)out_pos;
+}
+
+bool DecodeDelta(u8* dest, u32 dest_size, const u8* encoded, u32 encoded_size) {
+    u32 in = 0;
+    u32 pos = 0;
+
+    while (in + 8 <= encoded_size) {
+        u32 skip, copy;
+        memcpy(&skip, encoded + in, 4);
+        memcpy(&copy, encoded + in + 4, 4);
+        in += 8;
+
+        if (skip > dest_size - pos || copy > dest_size - pos - skip ||
+            copy > encoded_size - in)
+            return false;
+
+        pos += skip;
+        memcpy(dest + pos, encoded + in, copy);
+        pos += copy;
+        in += copy;
+    }
+    return true;
+}
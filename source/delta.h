@@ -0,0 +1,19 @@
+// Skip/copy delta codec for memory-update payloads.
+//
+// A delta is a sequence of records: u32 skip (bytes unchanged), u32 copy
+// (literal byte count), followed by the literal bytes. Bytes past the last
+// record are unchanged. Captured titles re-upload barely-modified buffers
+// constantly, so most payloads collapse to a few small literal spans.
+
+#pragma once
+
+#include <3ds/types.h>
+
+// Encodes `next` against `prev` into `out`. Returns the encoded size, or -1
+// if it would reach `cap` (caller stores the payload raw instead).
+s32 EncodeDelta(const u8* prev, const u8* next, u32 size, u8* out, u32 cap);
+
+// Applies an encoded delta onto `dest` in place. The skip/copy counts come
+// from a file; returns false if a record would step outside `dest_size` or
+// past the encoded bytes, leaving `dest` partially updated.
+bool DecodeDelta(u8* dest, u32 dest_size, const u8* encoded, u32 encoded_size);
@@ -0,0 +1,145 @@
+#include <3ds.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "fb_verify.h"
+#include "mem_map.h"
+
+namespace FbVerify {
+
+namespace {
+
+const u32 kHashFileMagic = 0x31484246; // "FBH1"
+
+bool active = false;
+
+// Last submitted PPF output setup.
+u32 out_addr = 0; // player-physical
+u32 out_dims = 0;
+u32 out_flags = 0;
+
+std::vector<u32> hashes;
+
+u32 BytesPerPixel(u32 format) {
+    switch (format & 7) {
+    case 0: return 4; // RGBA8
+    case 1: return 3; // RGB8
+    default: return 2; // RGB565 / RGB5A1 / RGBA4
+    }
+}
+
+// FNV-1a over words, two at a time; ~1ms for a 240x400x3 buffer, versus
+// tens of ms for a naive byte loop.
+u32 HashWords(const u32* data, u32 count) {
+    u32 h = 2166136261u;
+    u32 i = 0;
+    for (; i + 2 <= count; i += 2) {
+        h = (h ^ data[i]) * 16777619u;
+        h = (h ^ data[i + 1]) * 16777619u;
+    }
+    for (; i < count; i++)
+        h = (h ^ data[i]) * 16777619u;
+    return h;
+}
+
+} // namespace
+
+void Enable(bool on) {
+    active = on;
+    hashes.clear();
+    out_addr = out_dims = out_flags = 0;
+}
+
+bool Active() {
+    return active;
+}
+
+void NoteRegWrite(u32 offset, u32 value) {
+    switch (offset) {
+    case 0x0C04: out_addr = value << 3; break;
+    case 0x0C08: out_dims = value; break;
+    case 0x0C10: out_flags = value; break;
+    }
+}
+
+void OnFrame() {
+    if (!active)
+        return;
+
+    u32 hash = 0;
+
+    if (out_addr && out_dims) {
+        u32 width = out_dims & 0xFFFF;
+        u32 height = out_dims >> 16;
+        u32 bytes = width * height * BytesPerPixel(out_flags >> 8);
+
+        // Only FCRAM output is CPU-visible to us; a transfer into VRAM
+        // hashes as zero on every build equally.
+        const u8* host = g_mem_map.HostPointer(out_addr, bytes);
+        if (host)
+            hash = HashWords((const u32*)host, bytes / 4);
+    }
+
+    hashes.push_back(hash);
+}
+
+int Finish(const char* trace_path) {
+    if (!active || hashes.empty())
+        return 0;
+
+    char hash_path[256];
+    snprintf(hash_path, sizeof(hash_path), "%s.fbh", trace_path);
+
+    FS_Archive sdmc;
+    if (R_FAILED(FSUSER_OpenArchive(&sdmc, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""))))
+        return 0;
+
+    int mismatches = 0;
+    Handle file;
+
+    if (R_SUCCEEDED(FSUSER_OpenFile(&file, sdmc, fsMakePath(PATH_ASCII, hash_path),
+                                    FS_OPEN_READ, 0))) {
+        // Reference exists: compare.
+        u32 header[2] = {};
+        u32 bytes_read = 0;
+        FSFILE_Read(file, &bytes_read, 0, header, sizeof(header));
+
+        if (header[0] != kHashFileMagic || header[1] != hashes.size()) {
+            printf("verify: %s doesn't match this trace (%lu vs %u frames)\n", hash_path,
+                   header[1], hashes.size());
+            mismatches = 1;
+        } else {
+            std::vector<u32> expected(hashes.size());
+            FSFILE_Read(file, &bytes_read, sizeof(header), expected.data(),
+                        expected.size() * 4);
+            for (size_t i = 0; i < hashes.size(); i++) {
+                if (hashes[i] != expected[i]) {
+                    if (mismatches < 5)
+                        printf("verify: frame %u hash %08lx, expected %08lx\n", i,
+                               hashes[i], expected[i]);
+                    mismatches++;
+                }
+            }
+            printf("verify: %d/%u frames mismatched\n", mismatches, hashes.size());
+        }
+        FSFILE_Close(file);
+    } else if (R_SUCCEEDED(FSUSER_OpenFile(&file, sdmc, fsMakePath(PATH_ASCII, hash_path),
+                                           FS_OPEN_WRITE | FS_OPEN_CREATE, 0))) {
+        // No reference yet: record one.
+        u32 header[2] = {kHashFileMagic, (u32)hashes.size()};
+        u32 written = 0;
+        FSFILE_Write(file, &written, 0, header, sizeof(header), 0);
+        FSFILE_Write(file, &written, sizeof(header), hashes.data(), hashes.size() * 4,
+                     FS_WRITE_FLUSH);
+        FSFILE_Close(file);
+        printf("verify: recorded %u frame hashes to %s\n", hashes.size(), hash_path);
+    }
+
+    FSUSER_CloseArchive(sdmc);
+    hashes.clear();
+    return mismatches;
+}
+
+} // namespace FbVerify
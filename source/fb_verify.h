@@ -0,0 +1,32 @@
+// Frame hash verification.
+//
+// Tracks the PPF display-transfer output registers as they are submitted
+// and, at each frame marker, hashes the final transfer's output buffer with
+// a word-at-a-time FNV kernel. Hashes are compared against <trace>.fbh when
+// it exists; otherwise a replay records one, so the first verified run of a
+// known-good build produces the reference the farm checks later builds
+// against.
+
+#pragma once
+
+#include <3ds/types.h>
+
+namespace FbVerify {
+
+void Enable(bool on);
+bool Active();
+
+// Called for every external register submission (from the batcher); tracks
+// transfer output address, dimensions and format. `value` is the final
+// value the GPU sees.
+void NoteRegWrite(u32 offset, u32 value);
+
+// Hashes the current frame's output buffer; call at each frame marker.
+void OnFrame();
+
+// Compares recorded hashes against <trace_path>.fbh, or writes the file if
+// it doesn't exist. Returns the number of mismatched frames (0 also when
+// recording). Resets per-trace state.
+int Finish(const char* trace_path);
+
+} // namespace FbVerify
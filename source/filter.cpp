@@ -0,0 +1,130 @@
+#include <cstdlib>
+
+#include "filter.h"
+
+namespace Filter {
+
+namespace {
+
+// Word count of the external register block, matching the batcher's shadow.
+const u32 kRegWords = 0x1A00 / 4;
+
+// One bit per external register word; set means "drop writes to it".
+u32 reg_bits[(kRegWords + 31) / 32];
+
+struct AddrRange {
+    u32 lo;
+    u32 hi; // inclusive
+};
+const u32 kMaxAddrRanges = 8;
+AddrRange addr_ranges[kMaxAddrRanges];
+u32 addr_range_count = 0;
+
+bool all_loads = false;
+bool any = false;
+
+u32 dropped_regs = 0;
+u32 dropped_loads = 0;
+
+// "<lo>" or "<lo>-<hi>", decimal or 0x-hex.
+bool ParseRange(const char* s, u32* lo, u32* hi) {
+    char* end = nullptr;
+    *lo = strtoul(s, &end, 0);
+    if (end == s)
+        return false;
+    if (*end == '-') {
+        const char* p = end + 1;
+        *hi = strtoul(p, &end, 0);
+        if (end == p)
+            return false;
+    } else {
+        *hi = *lo;
+    }
+    return *end == 0 && *lo <= *hi;
+}
+
+} // namespace
+
+bool Parse(const char* spec) {
+    switch (spec[0]) {
+    case 'm':
+        if (spec[1])
+            return false;
+        all_loads = true;
+        any = true;
+        return true;
+
+    case 'r': {
+        u32 lo, hi;
+        if (!ParseRange(spec + 1, &lo, &hi))
+            return false;
+        if (lo >= 0x10400000)
+            lo -= 0x10400000;
+        if (hi >= 0x10400000)
+            hi -= 0x10400000;
+        if (lo >= kRegWords * 4)
+            return false;
+        if (hi >= kRegWords * 4)
+            hi = kRegWords * 4 - 1;
+        for (u32 word = lo / 4; word <= hi / 4; word++)
+            reg_bits[word / 32] |= 1u << (word % 32);
+        any = true;
+        return true;
+    }
+
+    case 'a': {
+        u32 lo, hi;
+        if (!ParseRange(spec + 1, &lo, &hi) || addr_range_count == kMaxAddrRanges)
+            return false;
+        addr_ranges[addr_range_count].lo = lo;
+        addr_ranges[addr_range_count].hi = hi;
+        addr_range_count++;
+        any = true;
+        return true;
+    }
+
+    default:
+        return false;
+    }
+}
+
+bool Active() {
+    return any;
+}
+
+bool DropReg(u32 offset) {
+    u32 word = offset / 4;
+    if (word >= kRegWords || !(reg_bits[word / 32] & (1u << (word % 32))))
+        return false;
+    dropped_regs++;
+    return true;
+}
+
+bool DropLoad(u32 trace_addr, u32 size) {
+    if (all_loads) {
+        dropped_loads++;
+        return true;
+    }
+    for (u32 i = 0; i < addr_range_count; i++) {
+        if (trace_addr <= addr_ranges[i].hi && addr_ranges[i].lo < trace_addr + size) {
+            dropped_loads++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ResetCounters() {
+    dropped_regs = 0;
+    dropped_loads = 0;
+}
+
+u32 DroppedRegs() {
+    return dropped_regs;
+}
+
+u32 DroppedLoads() {
+    return dropped_loads;
+}
+
+} // namespace Filter
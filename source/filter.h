@@ -0,0 +1,40 @@
+// Stream-element filter engine.
+//
+// Triage often wants "everything except texture uploads" or "only what
+// touches one register block" without editing the trace on a PC. -x specs
+// are compiled at startup into flat tables - a bitmask over the external
+// register file and a short address-range list - so the decode hot loop
+// pays one bit test per register write instead of a generic predicate
+// match per element.
+//
+// Filters act on the decoded stream; runs with filters active bypass the
+// baked cache (its ops carry pre-resolved arena offsets, not the capture
+// addresses the predicates are written against) and stay out of the
+// statistics ledger.
+
+#pragma once
+
+#include <3ds.h>
+
+namespace Filter {
+
+// Compiles one -x spec into the tables:
+//   m            all memory loads (texture/vertex uploads)
+//   r<lo>[-<hi>] register writes to external offsets in [lo, hi]; full
+//                0x104xxxxx MMIO addresses are accepted and rebased
+//   a<lo>[-<hi>] memory loads whose target intersects [lo, hi]
+// Returns false on a spec it can't parse.
+bool Parse(const char* spec);
+
+bool Active();
+
+// Hot-loop predicates; count what they drop.
+bool DropReg(u32 offset);
+bool DropLoad(u32 trace_addr, u32 size);
+
+// Per-replay drop counters for the exit summary.
+void ResetCounters();
+u32 DroppedRegs();
+u32 DroppedLoads();
+
+} // namespace Filter
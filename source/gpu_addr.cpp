@@ -0,0 +1,89 @@
+#include "gpu_addr.h"
+
+namespace {
+
+struct ExternalAddrReg {
+    u32 offset;
+    u32 shift;
+};
+
+const ExternalAddrReg kExternalAddrRegs[] = {
+    {0x0010, 3}, {0x0014, 3}, // PSC0 fill start/end
+    {0x0020, 3}, {0x0024, 3}, // PSC1 fill start/end
+    {0x0468, 0}, {0x046C, 0}, // PDC0 framebuffer A/B
+    {0x0494, 0}, {0x0498, 0}, // PDC0 framebuffer A/B (right eye)
+    {0x0568, 0}, {0x056C, 0}, // PDC1 framebuffer A/B
+    {0x0594, 0}, {0x0598, 0}, // PDC1 second framebuffer pair
+    {0x0C00, 3}, {0x0C04, 3}, // PPF transfer input/output
+    {0x18E8, 3},              // P3D command list address
+};
+
+} // namespace
+
+int ExternalRegAddrShift(u32 offset) {
+    for (const auto& r : kExternalAddrRegs) {
+        if (r.offset == offset)
+            return (int)r.shift;
+    }
+    return -1;
+}
+
+bool IsTriggerReg(u32 offset) {
+    return offset == 0x0018 || offset == 0x0028 || // PSC0/PSC1 fill
+           offset == 0x0C18 ||                     // PPF transfer
+           offset == 0x18F0;                       // P3D kick
+}
+
+bool IsPresentReg(u32 offset) {
+    if (offset >= 0x0400 && offset < 0x0600) // PDC0/PDC1
+        return true;
+    if (offset >= 0x0C00 && offset < 0x0D00) // PPF
+        return true;
+    return false;
+}
+
+bool InternalRegHoldsAddress(u32 reg_id) {
+    switch (reg_id) {
+    case 0x085: // GPUREG_TEXUNIT0_ADDR1..ADDR6
+    case 0x086: case 0x087: case 0x088: case 0x089: case 0x08A:
+    case 0x095: // GPUREG_TEXUNIT1_ADDR
+    case 0x09D: // GPUREG_TEXUNIT2_ADDR
+    case 0x11C: // GPUREG_DEPTHBUFFER_LOC
+    case 0x11D: // GPUREG_COLORBUFFER_LOC
+    case 0x200: // GPUREG_ATTRIBBUFFERS_LOC
+    case 0x238: // GPUREG_CMDBUF_ADDR0
+    case 0x239: // GPUREG_CMDBUF_ADDR1
+        return true;
+    default:
+        // Note: index buffer and per-attribute-buffer offsets are relative
+        // to GPUREG_ATTRIBBUFFERS_LOC and must not be rewritten.
+        return false;
+    }
+}
+
+void WalkCommandListAddresses(u32* words, u32 count, CommandWordCallback cb, void* ctx) {
+    u32 i = 0;
+
+    while (i + 1 < count) {
+        u32 value_index = i;
+        u32 header = words[i + 1];
+
+        u32 reg_id = header & 0xFFFF;
+        u32 extra = (header >> 20) & 0x7FF;
+        bool consecutive = (header & 0x80000000) != 0;
+
+        for (u32 j = 0; j <= extra; j++) {
+            u32 reg = consecutive ? reg_id + j : reg_id;
+            if (InternalRegHoldsAddress(reg)) {
+                u32 idx = (j == 0) ? value_index : i + 1 + j;
+                cb(&words[idx], reg, ctx);
+            }
+        }
+
+        // value word, header word, then `extra` further payload words,
+        // padded to 8-byte alignment.
+        u32 advance = 2 + extra;
+        advance = (advance + 1) & ~1u;
+        i += advance;
+    }
+}
@@ -0,0 +1,38 @@
+// Knowledge of which GPU registers carry physical addresses, shared by the
+// live replay path and the baked-trace compiler.
+
+#pragma once
+
+#include <3ds/types.h>
+
+// The player keeps external register offsets relative to physical
+// 0x10400000 everywhere. gsp's WriteHWRegs takes offsets relative to its
+// 0x1EB00000 register base, where the external GPU block sits at
+// +0x400000; rebase with this at the GSPGPU_WriteHWRegs boundary only.
+const u32 kGspExternalRegBase = 0x400000;
+
+// Returns the encoding shift for an address-bearing external register
+// (offset relative to physical 0x10400000): the register stores the address
+// shifted right by that amount. Returns -1 for registers that don't hold
+// addresses.
+int ExternalRegAddrShift(u32 offset);
+
+// External registers that fire work when written (PSC fill, PPF transfer,
+// P3D kick). They must always reach the hardware and never belong in a
+// snapshot.
+bool IsTriggerReg(u32 offset);
+
+// External registers that only matter for putting pixels on the LCD: the
+// PDC framebuffer setup and the PPF display-transfer engine. Headless
+// replay drops writes to them wholesale.
+bool IsPresentReg(u32 offset);
+
+// PICA internal registers whose payload words hold physical addresses
+// (always encoded >> 3). Offsets relative to an attribute/index base are
+// deliberately not listed; they relocate with their base register.
+bool InternalRegHoldsAddress(u32 reg_id);
+
+// Walks a GX command list and invokes `cb` for every payload word that
+// holds a physical address.
+typedef void (*CommandWordCallback)(u32* word, u32 reg_id, void* ctx);
+void WalkCommandListAddresses(u32* words, u32 count, CommandWordCallback cb, void* ctx);
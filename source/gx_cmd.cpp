@@ -0,0 +1,69 @@
+#include "gx_cmd.h"
+
+Result GxCmdBuilder::Init(u32 max_words) {
+    buf = (u32*)linearAlloc(max_words * 4);
+    if (!buf)
+        return -1;
+    cap = max_words;
+    len = 0;
+    return 0;
+}
+
+void GxCmdBuilder::Shutdown() {
+    if (buf) {
+        linearFree(buf);
+        buf = nullptr;
+    }
+    cap = len = 0;
+}
+
+void GxCmdBuilder::Write(u32 reg, u32 value, u32 mask) {
+    if (len + 2 > cap)
+        return;
+    buf[len++] = value;
+    buf[len++] = (reg & 0xFFFF) | (mask << 16);
+}
+
+void GxCmdBuilder::Burst(u32 reg, const u32* values, u32 count, bool consecutive) {
+    while (count > 0) {
+        u32 chunk = (count > 2048) ? 2048 : count;
+        u32 extra = chunk - 1;
+
+        // value, header, extra payload words, padded to 8-byte alignment.
+        u32 words = 2 + extra;
+        u32 padded = (words + 1) & ~1u;
+        if (len + padded > cap)
+            return;
+
+        buf[len++] = values[0];
+        buf[len++] = (reg & 0xFFFF) | (0xF << 16) | (extra << 20) |
+                     (consecutive ? 0x80000000 : 0);
+        for (u32 i = 1; i < chunk; i++)
+            buf[len++] = values[i];
+        if (words != padded)
+            buf[len++] = 0;
+
+        values += chunk;
+        count -= chunk;
+        if (consecutive)
+            reg += chunk;
+    }
+}
+
+Result GxCmdBuilder::Submit() {
+    if (len == 0)
+        return 0;
+
+    // The command processor wants a 16-byte-aligned list length; pad with
+    // masked-out writes that touch nothing.
+    while (len % 4)
+        Write(0, 0, 0);
+
+    GSPGPU_FlushDataCache(buf, len * 4);
+    Result res = GX_ProcessCommandList(buf, len * 4, 0);
+    if (R_FAILED(res))
+        return res;
+    gspWaitForP3D();
+    len = 0;
+    return 0;
+}
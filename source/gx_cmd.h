@@ -0,0 +1,35 @@
+// Small builder for GX (P3D) command lists.
+//
+// Encodes single writes and burst writes - one header followed by payload
+// words, incrementing or non-incrementing - into a linear-heap buffer and
+// submits the whole thing with one GX_ProcessCommandList call.
+
+#pragma once
+
+#include <3ds.h>
+
+class GxCmdBuilder {
+public:
+    Result Init(u32 max_words);
+    void Shutdown();
+
+    void Reset() { len = 0; }
+
+    // Single register write with a byte-enable mask.
+    void Write(u32 reg, u32 value, u32 mask = 0xF);
+
+    // Burst write: `count` payload words to `reg` (consecutive = false) or
+    // to reg, reg+1, ... (consecutive = true). Splits bursts longer than
+    // the encoding's 2048-word limit.
+    void Burst(u32 reg, const u32* values, u32 count, bool consecutive);
+
+    // Flushes, submits and waits for the command processor to finish.
+    Result Submit();
+
+    u32 Words() const { return len; }
+
+private:
+    u32* buf = nullptr;
+    u32 cap = 0;
+    u32 len = 0;
+};
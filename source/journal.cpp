@@ -0,0 +1,135 @@
+#include <cstdio>
+#include <cstring>
+
+#include "bench.h"
+#include "journal.h"
+
+namespace Journal {
+
+namespace {
+
+const char* kJournalPath = "/citrace-journal.bin";
+const char* kHangLogPath = "/citrace-hangs.txt";
+
+const u32 kJournalMagic = 0x6E6A5443; // "CTjn"
+
+// One aligned sector's worth; rewritten in place, never grown.
+struct Record {
+    u32 magic;
+    u32 frame;
+    u32 stage_us[Bench::kStageCount];
+    u32 pad;
+    char trace[228];
+};
+
+bool active = false;
+FS_Archive sdmc = 0;
+Handle file = 0;
+char current_trace[sizeof(Record::trace)];
+
+char bad_trace[sizeof(Record::trace)] = {};
+u32 bad_frame = 0;
+
+} // namespace
+
+void CheckStale() {
+    FS_Archive archive;
+    if (R_FAILED(FSUSER_OpenArchive(&archive, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""))))
+        return;
+
+    Handle f;
+    if (R_FAILED(FSUSER_OpenFile(&f, archive, fsMakePath(PATH_ASCII, kJournalPath),
+                                 FS_OPEN_READ, 0))) {
+        FSUSER_CloseArchive(archive);
+        return;
+    }
+
+    Record rec;
+    u32 read = 0;
+    bool stale = R_SUCCEEDED(FSFILE_Read(f, &read, 0, &rec, sizeof(rec))) &&
+                 read == sizeof(rec) && rec.magic == kJournalMagic;
+    FSFILE_Close(f);
+
+    if (stale) {
+        rec.trace[sizeof(rec.trace) - 1] = 0;
+        strcpy(bad_trace, rec.trace);
+        bad_frame = rec.frame;
+        printf("previous run hung in %s near frame %lu; skipping it\n", bad_trace, bad_frame);
+        printf("(isolate with: -f %s %lu)\n", bad_trace, bad_frame);
+
+        // Persistent mark, one line per hang, for the farm to collect.
+        Handle log;
+        if (R_SUCCEEDED(FSUSER_OpenFile(&log, archive, fsMakePath(PATH_ASCII, kHangLogPath),
+                                        FS_OPEN_WRITE | FS_OPEN_CREATE, 0))) {
+            u64 size = 0;
+            FSFILE_GetSize(log, &size);
+            char line[300];
+            int n = snprintf(line, sizeof(line), "%s frame %lu\n", bad_trace, bad_frame);
+            u32 written = 0;
+            FSFILE_Write(log, &written, size, line, n, FS_WRITE_FLUSH);
+            FSFILE_Close(log);
+        }
+    }
+
+    FSUSER_DeleteFile(archive, fsMakePath(PATH_ASCII, kJournalPath));
+    FSUSER_CloseArchive(archive);
+}
+
+bool IsBad(const char* trace_path) {
+    return bad_trace[0] && strcmp(trace_path, bad_trace) == 0;
+}
+
+u32 BadFrame() {
+    return bad_frame;
+}
+
+void Begin(const char* trace_path) {
+    if (active)
+        Finish();
+
+    if (R_FAILED(FSUSER_OpenArchive(&sdmc, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""))))
+        return;
+
+    FSUSER_DeleteFile(sdmc, fsMakePath(PATH_ASCII, kJournalPath));
+    if (R_FAILED(FSUSER_OpenFile(&file, sdmc, fsMakePath(PATH_ASCII, kJournalPath),
+                                 FS_OPEN_WRITE | FS_OPEN_CREATE, 0))) {
+        FSUSER_CloseArchive(sdmc);
+        sdmc = 0;
+        return;
+    }
+
+    strncpy(current_trace, trace_path, sizeof(current_trace) - 1);
+    current_trace[sizeof(current_trace) - 1] = 0;
+    active = true;
+    OnFrame(0); // the replay has begun; a hang before frame 1 still marks it
+}
+
+void OnFrame(u32 frame) {
+    if (!active || frame % kCheckpointInterval != 0)
+        return;
+
+    Record rec = {};
+    rec.magic = kJournalMagic;
+    rec.frame = frame;
+    for (u32 st = 0; st < Bench::kStageCount; st++)
+        rec.stage_us[st] = Bench::RunStageUs((Bench::Stage)st);
+    strcpy(rec.trace, current_trace);
+
+    // One flushed in-place write; if the GPU wedges after this, the frame
+    // number survives the power cycle.
+    u32 written = 0;
+    FSFILE_Write(file, &written, 0, &rec, sizeof(rec), FS_WRITE_FLUSH);
+}
+
+void Finish() {
+    if (!active)
+        return;
+    FSFILE_Close(file);
+    file = 0;
+    FSUSER_DeleteFile(sdmc, fsMakePath(PATH_ASCII, kJournalPath));
+    FSUSER_CloseArchive(sdmc);
+    sdmc = 0;
+    active = false;
+}
+
+} // namespace Journal
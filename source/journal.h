@@ -0,0 +1,38 @@
+// Crash-resilient replay journal.
+//
+// A GPU hang mid-trace takes the console down with it; on a farm that
+// loses the rest of the night's playlist. While a replay runs, the player
+// keeps a small journal record on SD - trace path, last checkpointed
+// frame, stage timings - rewritten in place every K frames and deleted on
+// clean completion. A journal still present at boot means the previous
+// run died inside that trace: the offending trace and frame are printed,
+// appended to a persistent hang log, and the trace is skipped for this
+// boot so the playlist completes. The recorded frame number feeds
+// straight into hold-frame mode for isolating the hang.
+
+#pragma once
+
+#include <3ds.h>
+
+namespace Journal {
+
+// Frames between checkpoint writes.
+const u32 kCheckpointInterval = 64;
+
+// Looks for a journal left behind by a crashed run. Call once at startup,
+// before any replay; marks the offending trace for IsBad.
+void CheckStale();
+
+// Whether `trace_path` hung the previous run; such traces are skipped in
+// playlist mode. BadFrame is the last frame the crashed run checkpointed.
+bool IsBad(const char* trace_path);
+u32 BadFrame();
+
+// Opens the journal for one replay. Every kCheckpointInterval-th frame
+// marker OnFrame rewrites the record with a single flushed write; Finish
+// deletes it again on clean completion.
+void Begin(const char* trace_path);
+void OnFrame(u32 frame);
+void Finish();
+
+} // namespace Journal
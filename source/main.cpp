@@ -0,0 +1,777 @@
+// citrace-player: replays CiTrace (.ctf) captures against the real PICA200.
+//
+// The trace's initial state (register files, shader program, uniforms) is
+// applied first, then the element stream is walked: memory loads are copied
+// into linear memory, register writes are forwarded to the GPU through gsp,
+// and frame markers pace playback against VBlank. Physical addresses
+// recorded in the trace belong to the captured process, so every
+// address-bearing value is translated through a relocation map built from
+// the memory loads.
+
+#include <3ds.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "baked.h"
+#include "bench.h"
+#include "citrace.h"
+#include "fb_verify.h"
+#include "filter.h"
+#include "gpu_addr.h"
+#include "gx_cmd.h"
+#include "journal.h"
+#include "mem_flush.h"
+#include "mem_map.h"
+#include "net_server.h"
+#include "pacing.h"
+#include "platform.h"
+#include "playlist.h"
+#include "present.h"
+#include "reg_batch.h"
+#include "stats_ledger.h"
+#include "trace_arena.h"
+#include "trace_check.h"
+#include "trace_reader.h"
+
+static const char* kDefaultTracePath = "/citrace.ctf";
+
+// -f: loop the start frame from a pre-frame snapshot instead of playing on.
+static bool g_hold_frame = false;
+
+static u32 TranslateAddr(u32 trace_addr) {
+    return g_mem_map.Translate(trace_addr);
+}
+
+// --- command list fixup ---------------------------------------------------
+
+// Rewrites every address-bearing payload word of a GX command list through
+// the trace-address map. Called right before the list is handed to the GPU.
+static void FixupCommandList(u8* list, u32 size_bytes) {
+    WalkCommandListAddresses(
+        (u32*)list, size_bytes / 4,
+        [](u32* word, u32 reg_id, void* ctx) { *word = TranslateAddr(*word << 3) >> 3; },
+        nullptr);
+}
+
+// --- register writes ------------------------------------------------------
+
+static const u32 kP3DCmdListSizeOffset = 0x18E0;
+static const u32 kP3DCmdListAddrOffset = 0x18E8;
+static const u32 kP3DTriggerOffset = 0x18F0;
+
+// Last observed command list setup, kept so the trigger write can fix the
+// list up before the GPU fetches it.
+static u32 g_cmdlist_addr = 0; // translated physical address
+static u32 g_cmdlist_size = 0; // bytes
+
+static void WriteExternalReg(u32 offset, u32 value) {
+    // One bit test against the compiled filter table; no-op when no -x
+    // spec names registers.
+    if (Filter::DropReg(offset))
+        return;
+
+    int shift = ExternalRegAddrShift(offset);
+    if (shift >= 0)
+        value = TranslateAddr(value << shift) >> shift;
+
+    if (offset == kP3DCmdListSizeOffset)
+        g_cmdlist_size = value << 3;
+
+    if (offset == kP3DCmdListAddrOffset)
+        g_cmdlist_addr = value << 3;
+
+    // During fast-forward the GPU never fetches the list, so there is
+    // nothing to fix up; the trigger itself is dropped in the batch stage.
+    if (offset == kP3DTriggerOffset && g_cmdlist_addr && !g_reg_batch.Deferred()) {
+        u8* host = g_mem_map.HostPointer(g_cmdlist_addr, g_cmdlist_size);
+        if (host) {
+            FixupCommandList(host, g_cmdlist_size);
+            MemFlush::NoteDirty(host, g_cmdlist_size);
+        }
+    }
+
+    // Consecutive writes coalesce into one gsp submission; the batch is
+    // flushed before anything that must observe them.
+    g_reg_batch.Queue(offset, value);
+}
+
+static void ApplyRegisterWrite(const CiTrace::CTRegisterWrite& w) {
+    u32 addr = w.physical_address;
+
+    // LCD configuration registers (backlight, ABL) are owned by gsp on a
+    // live console; replaying them would fight the system, and nothing the
+    // GPU renders depends on them.
+    if (addr >= 0x10202000 && addr < 0x10203000)
+        return;
+
+    if (addr >= 0x10400000 && addr < 0x10500000) {
+        u32 offset = addr - 0x10400000;
+        switch (w.size) {
+        case CiTrace::CTRegisterWrite::SIZE_64:
+            WriteExternalReg(offset, (u32)w.value);
+            WriteExternalReg(offset + 4, (u32)(w.value >> 32));
+            break;
+        default:
+            // 8/16-bit writes are recorded for a handful of registers; the
+            // hardware latches them as word writes, which gsp also does.
+            WriteExternalReg(offset, (u32)w.value);
+            break;
+        }
+    }
+}
+
+// --- memory loads ---------------------------------------------------------
+
+static bool ApplyMemoryLoad(TraceReader& reader, const CiTrace::CTMemoryLoad& load) {
+    // Filtered loads are skipped wholesale: no arena home, no SD read, no
+    // flush. Whatever the GPU reads there is stale or unmapped - that is
+    // the point of filtering them.
+    if (Filter::DropLoad(load.physical_address, load.size))
+        return true;
+
+    u8* dest = g_mem_map.Place(load.physical_address, load.size);
+    if (!dest) {
+        printf("no arena home for 0x%08lx+%lu (used %lu/%lu)\n", load.physical_address,
+               load.size, g_mem_map.BytesUsed(), g_mem_map.BytesTotal());
+        return false;
+    }
+
+    // The payload is read straight into its GPU-visible home; no staging
+    // buffer, no copy.
+    if (R_FAILED(reader.ReadAt(load.file_offset, dest, load.size))) {
+        printf("payload read failed at 0x%08lx\n", load.file_offset);
+        return false;
+    }
+
+    // Flushes coalesce; the extent hits RAM before the next trigger fires.
+    MemFlush::NoteDirty(dest, load.size);
+    return true;
+}
+
+// --- initial state --------------------------------------------------------
+
+// Registers it is not safe to blindly restore: command processor and draw
+// triggers, and the shader upload ports handled separately below.
+static bool SkipInternalReg(u32 reg_id) {
+    switch (reg_id) {
+    case 0x22E: // GPUREG_DRAWARRAYS
+    case 0x22F: // GPUREG_DRAWELEMENTS
+    case 0x232: case 0x233: case 0x234: case 0x235: // fixed attribute port
+    case 0x23C: // GPUREG_CMDBUF_JUMP
+    case 0x23D:
+        return true;
+    default:
+        return (reg_id >= 0x290 && reg_id <= 0x2DF); // shader/uniform ports
+    }
+}
+
+static u32* ReadSection(TraceReader& reader, u32 offset, u32 size_words) {
+    if (!size_words)
+        return nullptr;
+    u32* buf = g_trace_arena.AllocArray<u32>(size_words);
+    if (!buf || R_FAILED(reader.ReadAt(offset, buf, size_words * 4)))
+        return nullptr;
+    return buf;
+}
+
+// Restores one shader unit: program words, operand descriptors and the
+// float uniform file, each as a single non-incrementing burst to the
+// respective transfer port. `base` is 0x2B0 for the vertex shader and 0x280
+// for the geometry shader.
+static void ApplyShaderState(GxCmdBuilder& cmd, u32 base, const u32* program,
+                             u32 program_words, const u32* swizzle, u32 swizzle_words,
+                             const u32* uniforms, u32 uniform_words) {
+    if (program) {
+        cmd.Write(base + 0x1B, 0); // CODETRANSFER_CONFIG: offset 0
+        cmd.Burst(base + 0x1C, program, program_words, false);
+        cmd.Write(base + 0x0F, 1); // CODETRANSFER_END
+    }
+
+    if (swizzle) {
+        cmd.Write(base + 0x25, 0); // OPDESCS_CONFIG: offset 0
+        cmd.Burst(base + 0x26, swizzle, swizzle_words, false);
+    }
+
+    if (uniforms) {
+        cmd.Write(base + 0x10, 0x80000000); // FLOATUNIFORM: f32, index 0
+        cmd.Burst(base + 0x11, uniforms, uniform_words, false);
+    }
+}
+
+static bool ApplyInitialState(TraceReader& reader, const CiTrace::CTHeader& header) {
+    const auto& s = header.initial_state_offsets;
+
+    u32* gpu_regs = ReadSection(reader, s.gpu_registers, s.gpu_registers_size);
+    u32* pica_regs = ReadSection(reader, s.pica_registers, s.pica_registers_size);
+    u32* default_attrs = ReadSection(reader, s.default_attributes, s.default_attributes_size);
+    u32* vs_program = ReadSection(reader, s.vs_program_binary, s.vs_program_binary_size);
+    u32* vs_swizzle = ReadSection(reader, s.vs_swizzle_data, s.vs_swizzle_data_size);
+    u32* vs_uniforms = ReadSection(reader, s.vs_float_uniforms, s.vs_float_uniforms_size);
+    u32* gs_program = ReadSection(reader, s.gs_program_binary, s.gs_program_binary_size);
+    u32* gs_swizzle = ReadSection(reader, s.gs_swizzle_data, s.gs_swizzle_data_size);
+    u32* gs_uniforms = ReadSection(reader, s.gs_float_uniforms, s.gs_float_uniforms_size);
+
+    // External registers, one gsp call each. Trigger registers are skipped;
+    // the framebuffer/transfer setup among them goes through the usual
+    // address translation in WriteExternalReg.
+    if (gpu_regs) {
+        for (u32 i = 0; i < s.gpu_registers_size; i++) {
+            u32 offset = i * 4;
+            if (IsTriggerReg(offset))
+                continue; // PSC/PPF/P3D triggers
+            WriteExternalReg(offset, gpu_regs[i]);
+        }
+        g_reg_batch.Flush();
+    }
+
+    // Everything below goes into one command list: incrementing bursts over
+    // the contiguous restorable ranges of the register file, then the
+    // shader uploads, submitted with a single GX round trip.
+    GxCmdBuilder cmd;
+    if (R_FAILED(cmd.Init(8192))) {
+        printf("no memory for initial-state command list\n");
+        return false;
+    }
+
+    if (pica_regs) {
+        u32 run_start = 0;
+        u32 run_len = 0;
+        for (u32 i = 0; i < s.pica_registers_size; i++) {
+            if (SkipInternalReg(i)) {
+                if (run_len)
+                    cmd.Burst(run_start, &pica_regs[run_start], run_len, true);
+                run_len = 0;
+                continue;
+            }
+            if (run_len == 0)
+                run_start = i;
+            run_len++;
+        }
+        if (run_len)
+            cmd.Burst(run_start, &pica_regs[run_start], run_len, true);
+    }
+
+    // Fixed/default vertex attributes: 3 words of packed float24 per
+    // attribute, through the fixed-attribute port.
+    if (default_attrs) {
+        for (u32 attr = 0; attr * 3 + 2 < s.default_attributes_size; attr++) {
+            cmd.Write(0x232, attr);
+            cmd.Burst(0x233, &default_attrs[attr * 3], 3, false);
+        }
+    }
+
+    ApplyShaderState(cmd, 0x2B0, vs_program, s.vs_program_binary_size, vs_swizzle,
+                     s.vs_swizzle_data_size, vs_uniforms, s.vs_float_uniforms_size);
+    ApplyShaderState(cmd, 0x280, gs_program, s.gs_program_binary_size, gs_swizzle,
+                     s.gs_swizzle_data_size, gs_uniforms, s.gs_float_uniforms_size);
+
+    Result res = cmd.Submit();
+    cmd.Shutdown();
+    if (R_FAILED(res)) {
+        printf("initial-state submission failed (%08lX)\n", res);
+        return false;
+    }
+
+    // Section buffers came from the trace arena; they go away with it.
+    return true;
+}
+
+// --- replay loop ----------------------------------------------------------
+
+// Decodes and applies the element stream directly from the trace file; the
+// fallback when no baked cache can be used. Frames before `start_frame` are
+// fast-forwarded: memory loads land normally, register writes accumulate in
+// the shadow, and nothing is rendered until the target frame.
+static bool ReplayLive(TraceReader& reader, const CiTrace::CTHeader& header, u32 start_frame,
+                       u32* frames, bool* aborted_out) {
+    // Only the stream section is windowed; everything read so far was a
+    // handful of positioned reads.
+    u64 stream_bytes = (u64)header.stream_size * sizeof(CiTrace::CTStreamElement);
+    if (R_FAILED(reader.BeginStream(header.stream_offset, stream_bytes))) {
+        printf("stream read failed\n");
+        return false;
+    }
+
+    u32 frame = 0;
+    bool aborted = false;
+
+    if (start_frame > 0)
+        g_reg_batch.SetDeferred(true);
+
+    for (u32 i = 0; i < header.stream_size; i++) {
+        const auto* element =
+            (const CiTrace::CTStreamElement*)reader.FetchStream(sizeof(CiTrace::CTStreamElement));
+        if (!element) {
+            printf("stream truncated at element %lu\n", i);
+            aborted = true;
+            break;
+        }
+
+        // Register-write runs batch freely; anything else is a point the
+        // GPU must observe the writes, so the pending run goes out first.
+        if (element->type != CiTrace::RegisterWrite)
+            g_reg_batch.Flush();
+
+        switch (element->type) {
+        case CiTrace::FrameMarker: {
+            if (g_reg_batch.Deferred()) {
+                // The frame was never rendered; count it, and resume real
+                // submission with one burst once the target is reached.
+                frame++;
+                if (frame == start_frame) {
+                    g_reg_batch.SetDeferred(false);
+                    g_reg_batch.SubmitShadow();
+                }
+                break;
+            }
+            MemFlush::Commit(); // scanout reads memory without a trigger
+            FbVerify::OnFrame();
+            frame++;
+            Journal::OnFrame(frame);
+            u64 t0 = Bench::Now();
+            Pacing::FrameWait();
+            Bench::Add(Bench::kGpu, t0);
+            Bench::FrameEnd();
+            hidScanInput();
+            if (hidKeysDown() & KEY_START)
+                aborted = true;
+            break;
+        }
+        case CiTrace::MemoryLoad:
+            if (!ApplyMemoryLoad(reader, element->memory_load))
+                aborted = true;
+            break;
+        case CiTrace::RegisterWrite:
+            ApplyRegisterWrite(element->register_write);
+            break;
+        default:
+            printf("unknown element type 0x%lx at %lu\n", (u32)element->type, i);
+            aborted = true;
+            break;
+        }
+
+        if (aborted)
+            break;
+    }
+
+    // A start frame past the end of the trace: the whole stream was applied
+    // deferred; land the final state so the screen shows the last frame.
+    if (g_reg_batch.Deferred()) {
+        g_reg_batch.SetDeferred(false);
+        g_reg_batch.SubmitShadow();
+    }
+
+    g_reg_batch.Flush();
+
+    *frames = frame;
+    *aborted_out = aborted;
+    return true;
+}
+
+static int ReplayTrace(const char* path, u32 start_frame, const u8* head = nullptr,
+                       u32 head_size = 0) {
+    g_trace_arena.Reset();
+    g_reg_batch.ResetShadow();
+    Bench::ResetRun();
+    Filter::ResetCounters();
+
+    TraceReader reader;
+    if (R_FAILED(reader.Open(path))) {
+        printf("could not open %s\n", path);
+        return 1;
+    }
+    if (head)
+        reader.SetHeadCache(head, head_size);
+
+    if (R_FAILED(g_mem_map.Init())) {
+        printf("could not reserve linear arena\n");
+        reader.Close();
+        return 1;
+    }
+
+    CiTrace::CTHeader header;
+    if (R_FAILED(reader.ReadAt(0, &header, sizeof(header)))) {
+        printf("header read failed\n");
+        reader.Close();
+        return 1;
+    }
+
+    if (memcmp(header.magic, CiTrace::CTHeader::ExpectedMagicWord(), 4) != 0 ||
+        header.version != CiTrace::CTHeader::ExpectedVersion()) {
+        printf("not a CiTrace v%lu file\n", CiTrace::CTHeader::ExpectedVersion());
+        reader.Close();
+        return 1;
+    }
+
+    printf("trace: %llu bytes, %lu stream elements\n", reader.FileSize(), header.stream_size);
+
+    // Reject corrupted traces before any GPU state is touched; a bad one
+    // otherwise crashes the console mid-replay and wedges unattended runs.
+    if (!TraceCheck::Run(reader, header)) {
+        reader.Close();
+        return 1;
+    }
+
+    if (!ApplyInitialState(reader, header)) {
+        reader.Close();
+        return 1;
+    }
+
+    // From here the GPU can hang us; the journal survives the power cycle
+    // and names this trace on the next boot.
+    Journal::Begin(path);
+
+    char ctb_path[256];
+    Baked::CachePath(path, ctb_path, sizeof(ctb_path));
+
+    u32 frame = 0;
+    bool aborted = false;
+    bool replayed = false;
+    u64 run_start = Bench::Now();
+
+    if (g_hold_frame) {
+        // Hold mode loops the start frame from a pre-frame snapshot; START
+        // is the normal way out, not an abort.
+        replayed =
+            Baked::HoldFrame(ctb_path, reader.FileSize(), start_frame, &aborted, g_mem_map);
+        if (!replayed && Baked::Compile(reader, header, ctb_path, g_mem_map)) {
+            g_mem_map.Reset();
+            replayed = Baked::HoldFrame(ctb_path, reader.FileSize(), start_frame, &aborted,
+                                        g_mem_map);
+        }
+        if (!replayed)
+            printf("hold mode needs a baked cache\n");
+        aborted = false;
+    } else {
+        // A fresh cache skips stream parsing entirely; a missing or stale
+        // one gets built first so the next run is the fast one too.
+        // Filters act on the decoded stream, so filtered runs always take
+        // the live path.
+        if (!Filter::Active()) {
+            replayed = Baked::Replay(ctb_path, reader.FileSize(), start_frame, &frame,
+                                     &aborted, g_mem_map);
+            if (!replayed) {
+                if (Baked::Compile(reader, header, ctb_path, g_mem_map)) {
+                    g_mem_map.Reset();
+                    replayed = Baked::Replay(ctb_path, reader.FileSize(), start_frame, &frame,
+                                             &aborted, g_mem_map);
+                }
+            }
+        }
+
+        if (!replayed)
+            replayed = ReplayLive(reader, header, start_frame, &frame, &aborted);
+    }
+
+    printf("replayed %lu frames%s\n", frame, aborted ? " (aborted)" : "");
+    if (Pacing::Headless() && frame > 0) {
+        u64 elapsed = Bench::Now() - run_start;
+        u64 fps10 = (u64)frame * Bench::kTicksPerSecond * 10 / elapsed;
+        printf("headless: %llu.%llu fps\n", fps10 / 10, fps10 % 10);
+    }
+    if (g_reg_batch.ElidedCount() > 0)
+        printf("elided %lu redundant register writes\n", g_reg_batch.ElidedCount());
+    if (Filter::Active())
+        printf("filtered out %lu register writes, %lu loads\n", Filter::DroppedRegs(),
+               Filter::DroppedLoads());
+
+    int mismatches = FbVerify::Finish(path);
+
+    // Settle the source-trace CRC when this run streamed the whole stream
+    // section (live replay or a fresh bake); cached runs settle the .ctb's
+    // own CRC inside Baked::Replay instead.
+    bool crc_ok = true;
+    if (replayed && !aborted)
+        crc_ok = TraceCheck::FinishCrc(path, reader);
+
+    // Only clean full replays enter the ledger; a seek, a filtered run or
+    // an aborted one would poison the wall-time baseline.
+    if (replayed && !aborted && start_frame == 0 && !g_hold_frame && !Filter::Active()) {
+        u32 wall_us = (u32)((Bench::Now() - run_start) * 1000000 / Bench::kTicksPerSecond);
+        u32 key = StatsLedger::TraceKey(&header, sizeof(header), reader.FileSize());
+        StatsLedger::Record(path, key, wall_us, frame, mismatches, crc_ok);
+    }
+
+    Journal::Finish();
+    g_mem_map.Shutdown();
+    reader.Close();
+    return (replayed && !aborted && mismatches == 0 && crc_ok) ? 0 : 1;
+}
+
+// --- A/B replay -----------------------------------------------------------
+
+// Opens one side of an A/B pair: validates the trace, applies its initial
+// state to its own screen, and gets a stepper onto a valid baked cache,
+// compiling one into this side's half of the arena if needed.
+static bool OpenAbSide(const char* path, RegBatch::Route route, MemMap& map,
+                       Baked::Stepper* stepper) {
+    TraceReader reader;
+    CiTrace::CTHeader header;
+    if (R_FAILED(reader.Open(path))) {
+        printf("could not open %s\n", path);
+        return false;
+    }
+    if (R_FAILED(reader.ReadAt(0, &header, sizeof(header))) ||
+        memcmp(header.magic, CiTrace::CTHeader::ExpectedMagicWord(), 4) != 0 ||
+        header.version != CiTrace::CTHeader::ExpectedVersion()) {
+        printf("%s is not a CiTrace v%lu file\n", path, CiTrace::CTHeader::ExpectedVersion());
+        reader.Close();
+        return false;
+    }
+
+    // Display writes go to this side's screen only. The internal-state
+    // part (shaders, pipeline) is shared hardware; the last side in wins,
+    // which is fine for captures that rebuild their state per frame.
+    g_reg_batch.SetRoute(route);
+    bool ok = ApplyInitialState(reader, header);
+    g_reg_batch.SetRoute(RegBatch::kRouteBoth);
+
+    char ctb_path[256];
+    Baked::CachePath(path, ctb_path, sizeof(ctb_path));
+
+    ok = ok && (stepper->Open(ctb_path, reader.FileSize(), map) ||
+                (Baked::Compile(reader, header, ctb_path, map) &&
+                 stepper->Open(ctb_path, reader.FileSize(), map)));
+    if (!ok)
+        printf("%s: no usable baked cache (trace too big for half the arena?)\n", path);
+
+    reader.Close();
+    return ok;
+}
+
+// Replays two traces in lockstep for visual regression triage: A on the
+// top screen, B on the bottom, the batcher rerouting B's display writes
+// onto PDC1. Both run from baked caches over halves of one shared arena,
+// through the same batching and flush-coalescing paths as single replay,
+// stepping one frame each under a single VBlank wait.
+static int ReplayAb(const char* path_a, const char* path_b) {
+    g_trace_arena.Reset();
+    g_reg_batch.ResetShadow();
+
+    // The usual automatic sizing leaves room for one reader's window ring;
+    // A/B keeps up to three readers open while the caches build.
+    u32 reserve = 2 * TraceReader::MaxWindows * Platform::StreamWindowSize() +
+                  4 * 1024 * 1024;
+    u32 free_bytes = linearSpaceFree();
+    if (free_bytes <= reserve || R_FAILED(g_mem_map.Init(free_bytes - reserve))) {
+        printf("could not reserve linear arena\n");
+        return 1;
+    }
+
+    MemMap map_a, map_b;
+    u32 half = (g_mem_map.BytesTotal() / 2) & ~15u;
+    if (R_FAILED(map_a.InitView(g_mem_map, 0, half)) ||
+        R_FAILED(map_b.InitView(g_mem_map, half, g_mem_map.BytesTotal() - half))) {
+        g_mem_map.Shutdown();
+        return 1;
+    }
+
+    Baked::Stepper a, b;
+    bool ok = OpenAbSide(path_a, RegBatch::kRouteTop, map_a, &a);
+    if (ok && !OpenAbSide(path_b, RegBatch::kRouteBottom, map_b, &b)) {
+        a.Close();
+        ok = false;
+    }
+    if (!ok) {
+        g_mem_map.Shutdown();
+        return 1;
+    }
+
+    printf("A/B: %s (%lu frames) top, %s (%lu frames) bottom; START exits\n", path_a,
+           a.FrameCount(), path_b, b.FrameCount());
+
+    bool aborted = false;
+    bool more_a = true;
+    bool more_b = true;
+    while ((more_a || more_b) && !aborted) {
+        if (more_a) {
+            g_reg_batch.SetRoute(RegBatch::kRouteTop);
+            more_a = a.Step();
+        }
+        if (more_b) {
+            g_reg_batch.SetRoute(RegBatch::kRouteBottom);
+            more_b = b.Step();
+        }
+        g_reg_batch.SetRoute(RegBatch::kRouteBoth);
+
+        u64 t0 = Bench::Now();
+        Pacing::FrameWait();
+        Bench::Add(Bench::kGpu, t0);
+        Bench::FrameEnd();
+        hidScanInput();
+        if (hidKeysDown() & KEY_START)
+            aborted = true;
+    }
+
+    bool failed = a.Failed() || b.Failed();
+    printf("A/B: stopped at frames %lu/%lu%s\n", a.Frame(), b.Frame(),
+           failed ? " (stream error)" : "");
+
+    a.Close();
+    b.Close();
+    g_mem_map.Shutdown();
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    gfxInitDefault();
+    consoleInit(GFX_BOTTOM, nullptr);
+
+    // 804MHz + L2 on n3DS; also decides where worker threads land and how
+    // big the reader's stream windows are.
+    Platform::Init();
+
+    // Grants the o3DS prefetch thread time on the syscore; without it
+    // threadCreate on core 1 fails and the reader runs synchronously.
+    // Harmless on n3DS, where workers live on core 2 instead.
+    APT_SetAppCpuTimeLimit(30);
+
+    if (R_FAILED(g_trace_arena.Init())) {
+        printf("could not reserve trace arena\n");
+        gfxExit();
+        return 1;
+    }
+
+    // A journal left on SD means the previous run hung mid-trace.
+    Journal::CheckStale();
+
+    // Usage: citrace-player [-bN] [trace.ctf | directory] [start frame]
+    //   -bN  benchmark mode: replay the trace N times and report per-stage
+    //        frame times (console summary + CSV next to the trace).
+    //   -v   verify frame hashes against <trace>.fbh, recording the file on
+    //        the first run.
+    //   -s   strict mode: submit every register write, even ones that store
+    //        the value the register already holds.
+    //   -u   uncapped pacing: don't align frame markers to VBlank; replay
+    //        as fast as the pipeline allows.
+    //   -d   decoupled: uncapped replay with the newest completed frame
+    //        latched to the top screen at each VBlank (see present.h).
+    //   -n   headless: uncapped, and display transfers / LCD setup are
+    //        dropped entirely; prints frames/second at exit.
+    //   -f   hold frame: replay to the start frame, then re-run just that
+    //        frame in a loop from its pre-frame snapshot (START exits).
+    //   -rN  read-ahead depth: N stream windows in the reader's ring
+    //        (default 3, max 8).
+    //   -l   listen: accept traces pushed over Wi-Fi (see net_server.h)
+    //        instead of reading a path.
+    //   -e   print the replay statistics ledger (per-trace best/last wall
+    //        time, regressions) and export it as CSV; no replay.
+    //   -a   A/B: replay two traces in lockstep, the first on the top
+    //        screen and the second on the bottom (see ReplayAb). The
+    //        second positional argument is the B trace, not a start frame.
+    //   -x<spec>  filter out stream elements (repeatable): m = all memory
+    //        loads, r<lo>[-<hi>] = register writes to those external
+    //        offsets, a<lo>[-<hi>] = loads targeting that address range.
+    //        Filtered runs replay live and stay out of the stats ledger.
+    // A directory runs playlist mode: every .ctf in it, back-to-back.
+    const char* path = kDefaultTracePath;
+    u32 start_frame = 0;
+    const char* path_b = nullptr;
+    u32 bench_iterations = 0;
+    bool listen_mode = false;
+    bool stats_mode = false;
+    bool ab_mode = false;
+    int positional = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == '-' && argv[i][1] == 'b') {
+            bench_iterations = (u32)atoi(argv[i] + 2);
+            if (bench_iterations == 0)
+                bench_iterations = 1;
+        } else if (strcmp(argv[i], "-v") == 0) {
+            FbVerify::Enable(true);
+        } else if (strcmp(argv[i], "-s") == 0) {
+            g_reg_batch.SetElide(false);
+        } else if (strcmp(argv[i], "-u") == 0) {
+            Pacing::SetMode(Pacing::kUncapped);
+        } else if (strcmp(argv[i], "-d") == 0) {
+            Pacing::SetMode(Pacing::kDecoupled);
+        } else if (strcmp(argv[i], "-n") == 0) {
+            Pacing::SetMode(Pacing::kHeadless);
+        } else if (strcmp(argv[i], "-f") == 0) {
+            g_hold_frame = true;
+        } else if (strcmp(argv[i], "-l") == 0) {
+            listen_mode = true;
+        } else if (strcmp(argv[i], "-e") == 0) {
+            stats_mode = true;
+        } else if (strcmp(argv[i], "-a") == 0) {
+            ab_mode = true;
+        } else if (argv[i][0] == '-' && argv[i][1] == 'x' && argv[i][2]) {
+            if (!Filter::Parse(argv[i] + 2))
+                printf("bad filter spec: %s\n", argv[i] + 2);
+        } else if (argv[i][0] == '-' && argv[i][1] == 'r' && argv[i][2]) {
+            TraceReader::SetRingDepth((u32)atoi(argv[i] + 2));
+        } else if (positional == 0) {
+            path = argv[i];
+            positional++;
+        } else if (ab_mode) {
+            path_b = argv[i];
+            positional++;
+        } else {
+            start_frame = (u32)atoi(argv[i]);
+            positional++;
+        }
+    }
+
+    // The presenter owns the VBlank event for the rest of the run; without
+    // it decoupled pacing would tear mid-flip like plain uncapped.
+    if (Pacing::GetMode() == Pacing::kDecoupled && R_FAILED(Present::Init())) {
+        printf("no presenter thread; falling back to uncapped\n");
+        Pacing::SetMode(Pacing::kUncapped);
+    }
+
+    int result;
+    if (ab_mode) {
+        if (path_b) {
+            result = ReplayAb(path, path_b);
+        } else {
+            printf("A/B mode needs two trace paths\n");
+            result = 1;
+        }
+    } else if (stats_mode) {
+        // Nonzero when any trace's last run regressed; the farm scripts
+        // key off the exit code.
+        result = StatsLedger::Summary();
+    } else if (listen_mode) {
+        result = NetServer::Run([](const char* trace, const u8* head, u32 head_size) {
+            return ReplayTrace(trace, 0, head, head_size);
+        });
+    } else if (Playlist::IsDirectory(path)) {
+        result = Playlist::Run(path, [](const char* trace, const u8* head, u32 head_size) {
+            // One hang costs one trace, not the night: the journal names
+            // the trace that took the console down last boot.
+            if (Journal::IsBad(trace)) {
+                printf("skipping %s (hung near frame %lu)\n", trace, Journal::BadFrame());
+                return 1;
+            }
+            return ReplayTrace(trace, 0, head, head_size);
+        });
+    } else if (bench_iterations > 0) {
+        Bench::StartRun(bench_iterations);
+        result = 0;
+        for (u32 i = 0; i < bench_iterations && result == 0; i++) {
+            printf("bench: iteration %lu/%lu\n", i + 1, bench_iterations);
+            Bench::BeginIteration(i);
+            result = ReplayTrace(path, start_frame);
+        }
+        Bench::Report(path);
+    } else {
+        result = ReplayTrace(path, start_frame);
+    }
+
+    Present::Shutdown(); // the exit loop below polls VBlank itself
+
+    printf("press START to exit\n");
+    while (aptMainLoop()) {
+        hidScanInput();
+        if (hidKeysDown() & KEY_START)
+            break;
+        gspWaitForVBlank();
+    }
+
+    gfxExit();
+    return result;
+}
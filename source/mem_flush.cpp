@@ -0,0 +1,72 @@
+#include "bench.h"
+#include "mem_flush.h"
+
+namespace MemFlush {
+
+namespace {
+
+// Extents closer than this merge even without touching; flushing the few
+// clean lines in between is cheaper than a second syscall.
+const u32 kMergeSlack = 4096;
+const u32 kMaxExtents = 16;
+
+struct Extent {
+    u8* start;
+    u8* end;
+};
+
+Extent g_extents[kMaxExtents];
+u32 g_count = 0;
+u32 g_flushes = 0;
+
+} // namespace
+
+void NoteDirty(void* ptr, u32 size) {
+    if (size == 0)
+        return;
+
+    u8* start = (u8*)ptr;
+    u8* end = start + size;
+
+    // Absorb every extent the new range overlaps or nearly touches; the
+    // grown range can reach further extents, so rescan until it settles.
+    bool merged;
+    do {
+        merged = false;
+        for (u32 i = 0; i < g_count; i++) {
+            Extent e = g_extents[i];
+            if (start > e.end + kMergeSlack || end + kMergeSlack < e.start)
+                continue;
+            if (e.start < start)
+                start = e.start;
+            if (e.end > end)
+                end = e.end;
+            g_extents[i] = g_extents[--g_count];
+            merged = true;
+            break;
+        }
+    } while (merged);
+
+    if (g_count == kMaxExtents)
+        Commit();
+
+    g_extents[g_count++] = {start, end};
+}
+
+void Commit() {
+    if (g_count == 0)
+        return;
+
+    u64 t0 = Bench::Now();
+    for (u32 i = 0; i < g_count; i++)
+        GSPGPU_FlushDataCache(g_extents[i].start, g_extents[i].end - g_extents[i].start);
+    Bench::Add(Bench::kUpload, t0);
+    g_flushes += g_count;
+    g_count = 0;
+}
+
+u32 FlushCount() {
+    return g_flushes;
+}
+
+} // namespace MemFlush
@@ -0,0 +1,25 @@
+// Coalesces data-cache flushes for memory uploads.
+//
+// Draw-heavy traces carry dozens of small memory updates per frame, often
+// to adjacent addresses; flushing each one is a separate gsp syscall and
+// was a measured hotspot. Uploads instead record their dirty extent here,
+// adjacent and overlapping extents are merged, and everything is flushed -
+// one GSPGPU_FlushDataCache per merged extent - right before the GPU can
+// observe the memory: at trigger-register writes and frame markers.
+
+#pragma once
+
+#include <3ds.h>
+
+namespace MemFlush {
+
+// Records [ptr, ptr+size) as written and in need of a cache flush.
+void NoteDirty(void* ptr, u32 size);
+
+// Flushes every pending extent. Cheap when nothing is dirty.
+void Commit();
+
+// Merged flushes issued so far (for the replay summary).
+u32 FlushCount();
+
+} // namespace MemFlush
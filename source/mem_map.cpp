@@ -0,0 +1,124 @@
+#include "mem_map.h"
+#include "trace_arena.h"
+
+MemMap g_mem_map;
+
+// Headroom left on the linear heap for the framebuffers, the reader's
+// windows and gsp's shared memory when sizing the arena automatically.
+static const u32 kLinearReserve = 4 * 1024 * 1024;
+
+Result MemMap::Init(u32 arena_bytes) {
+    if (arena_bytes == 0) {
+        u32 free_bytes = linearSpaceFree();
+        if (free_bytes <= kLinearReserve)
+            return -1;
+        arena_bytes = free_bytes - kLinearReserve;
+    }
+
+    arena = (u8*)linearAlloc(arena_bytes);
+    if (!arena)
+        return -1;
+
+    arena_size = arena_bytes;
+    arena_used = 0;
+    arena_phys = osConvertVirtToPhys(arena);
+    owns_arena = true;
+
+    ranges = g_trace_arena.AllocArray<Range>(MaxRanges);
+    range_count = 0;
+    return ranges ? 0 : -1;
+}
+
+Result MemMap::InitView(MemMap& owner, u32 offset, u32 bytes) {
+    if (offset + bytes > owner.arena_size)
+        return -1;
+
+    arena = owner.arena + offset;
+    arena_size = bytes;
+    arena_used = 0;
+    arena_phys = owner.arena_phys + offset;
+    owns_arena = false;
+
+    ranges = g_trace_arena.AllocArray<Range>(MaxRanges);
+    range_count = 0;
+    return ranges ? 0 : -1;
+}
+
+void MemMap::Shutdown() {
+    if (arena && owns_arena)
+        linearFree(arena);
+    arena = nullptr;
+    arena_size = arena_used = arena_phys = 0;
+    ranges = nullptr;
+    range_count = 0;
+}
+
+void MemMap::Reset() {
+    range_count = 0;
+    arena_used = 0;
+}
+
+u8* MemMap::Place(u32 trace_addr, u32 size, bool* fresh) {
+    if (fresh)
+        *fresh = false;
+
+    for (u32 i = 0; i < range_count; i++) {
+        const Range& r = ranges[i];
+        // Exact and interior re-loads hit the existing home.
+        if (trace_addr >= r.trace_addr && trace_addr + size <= r.trace_addr + r.size)
+            return arena + r.arena_offset + (trace_addr - r.trace_addr);
+
+        // Partial overlap with a differently-shaped range would alias two
+        // homes; traces produced by Citra don't do this.
+        if (trace_addr < r.trace_addr + r.size && r.trace_addr < trace_addr + size)
+            return nullptr;
+    }
+
+    // GPU buffer base addresses must be 16-byte aligned at worst (texture
+    // units); keeping every home aligned preserves whatever alignment the
+    // captured addresses had.
+    u32 offset = (arena_used + 15) & ~15u;
+    if (offset + size > arena_size)
+        return nullptr;
+
+    if (range_count == MaxRanges)
+        return nullptr;
+
+    Range& r = ranges[range_count++];
+    r.trace_addr = trace_addr;
+    r.size = size;
+    r.arena_offset = offset;
+
+    arena_used = offset + size;
+    if (fresh)
+        *fresh = true;
+    return arena + offset;
+}
+
+u32 MemMap::Translate(u32 trace_addr) const {
+    // VRAM is at the same physical location on every console.
+    if (trace_addr >= 0x18000000 && trace_addr < 0x18600000)
+        return trace_addr;
+
+    for (u32 i = 0; i < range_count; i++) {
+        const Range& r = ranges[i];
+        if (trace_addr >= r.trace_addr && trace_addr < r.trace_addr + r.size)
+            return arena_phys + r.arena_offset + (trace_addr - r.trace_addr);
+    }
+    return trace_addr;
+}
+
+s64 MemMap::TraceToArenaOffset(u32 trace_addr) const {
+    for (u32 i = 0; i < range_count; i++) {
+        const Range& r = ranges[i];
+        if (trace_addr >= r.trace_addr && trace_addr < r.trace_addr + r.size)
+            return (s64)r.arena_offset + (trace_addr - r.trace_addr);
+    }
+    return -1;
+}
+
+u8* MemMap::HostPointer(u32 player_phys, u32 size) const {
+    if (player_phys < arena_phys || player_phys + size > arena_phys + arena_used)
+        return nullptr;
+    return arena + (player_phys - arena_phys);
+}
@@ -0,0 +1,74 @@
+// Trace-address memory map backed by a single linear-heap arena.
+//
+// Every memory-load destination range from the trace gets a resident home
+// carved out of one GPU-visible arena, assigned on first sight and kept for
+// the lifetime of the trace. Payloads are read from SD straight into place,
+// so replaying a memory-update element is a cache flush, not a copy, and
+// teardown between traces frees one block instead of thousands.
+
+#pragma once
+
+#include <3ds.h>
+
+class MemMap {
+public:
+    // Carves the arena out of the linear heap. `arena_bytes` of 0 means
+    // "most of what is free", leaving a reserve for the framebuffers and
+    // the reader's windows.
+    Result Init(u32 arena_bytes = 0);
+    void Shutdown();
+
+    // Maps a slice of another map's arena instead of allocating one; A/B
+    // replay splits a single arena between two instances this way. The
+    // owner must outlive the view, and Shutdown releases nothing.
+    Result InitView(MemMap& owner, u32 offset, u32 bytes);
+
+    // Drops all ranges without releasing the arena; O(1) between traces.
+    void Reset();
+
+    // Returns the resident home for [trace_addr, trace_addr+size), bump-
+    // allocating one on first sight. Returns nullptr if the range straddles
+    // an existing one or the arena is exhausted. `fresh`, when given, is set
+    // if this call allocated the home (i.e. its contents are undefined).
+    u8* Place(u32 trace_addr, u32 size, bool* fresh = nullptr);
+
+    // Maps a physical address from the capture to the equivalent address in
+    // our process. VRAM passes through untouched; FCRAM goes through the
+    // range map; unknown addresses are returned unchanged.
+    u32 Translate(u32 trace_addr) const;
+
+    // CPU pointer for an already-translated physical address inside the
+    // arena, or nullptr if it isn't ours.
+    u8* HostPointer(u32 player_phys, u32 size) const;
+
+    // Arena-relative byte offset standing in for a captured physical
+    // address, or -1 if no range covers it. Placement is deterministic, so
+    // offsets computed in one pass are valid in a later one that replays
+    // the same load sequence.
+    s64 TraceToArenaOffset(u32 trace_addr) const;
+
+    u8* ArenaBase() const { return arena; }
+    u32 ArenaPhys() const { return arena_phys; }
+    u32 BytesUsed() const { return arena_used; }
+    u32 BytesTotal() const { return arena_size; }
+
+private:
+    struct Range {
+        u32 trace_addr;
+        u32 size;
+        u32 arena_offset;
+    };
+
+    // Range table lives in the per-trace arena; no per-range allocations.
+    static const u32 MaxRanges = 8192;
+    Range* ranges = nullptr;
+    u32 range_count = 0;
+
+    u8* arena = nullptr;
+    u32 arena_size = 0;
+    u32 arena_used = 0;
+    u32 arena_phys = 0;
+    bool owns_arena = true;
+};
+
+extern MemMap g_mem_map;
@@ -0,0 +1,228 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include "net_server.h"
+
+namespace NetServer {
+
+namespace {
+
+const u16 kPort = 17272;
+const char* kScratchPath = "/netplay.ctf";
+
+// soc:u service buffer; must be 0x1000-aligned, multiple of 0x1000.
+const u32 kSocBufferSize = 0x100000;
+
+const u32 kSpoolBufferSize = 256 * 1024;
+
+struct RequestHeader {
+    u32 magic; // "CTNP"
+    u32 name_len;
+    u32 size_lo;
+    u32 size_hi;
+};
+const u32 kRequestMagic = 0x504E5443;
+
+// Client receives run against a SO_RCVTIMEO of this long, so blocked recv
+// calls hand control back periodically instead of wedging the thread.
+const u32 kRecvTimeoutMs = 100;
+
+// A mid-transfer recv with no bytes for this many consecutive timeouts is
+// a dead sender, not a slow one.
+const u32 kRecvStallLimit = 100;
+
+bool RecvAll(int fd, void* dest, u32 size) {
+    u8* p = (u8*)dest;
+    u32 stalls = 0;
+    while (size > 0) {
+        ssize_t got = recv(fd, p, size, 0);
+        if (got == 0)
+            return false;
+        if (got < 0) {
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && ++stalls < kRecvStallLimit)
+                continue;
+            return false;
+        }
+        stalls = 0;
+        p += got;
+        size -= (u32)got;
+    }
+    return true;
+}
+
+// Waits for the next request header. The connection is persistent and sits
+// idle between pushes, so this wait may last minutes; each recv timeout
+// services the input loop so START keeps working between requests.
+// Returns 1 on a header, 0 when the peer closed or errored, -1 on exit.
+int RecvRequest(int fd, RequestHeader* req) {
+    u8* p = (u8*)req;
+    u32 have = 0;
+    while (have < sizeof(*req)) {
+        ssize_t got = recv(fd, p + have, sizeof(*req) - have, 0);
+        if (got > 0) {
+            have += (u32)got;
+            continue;
+        }
+        if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+            return 0;
+        if (!aptMainLoop())
+            return -1;
+        hidScanInput();
+        if (hidKeysDown() & KEY_START)
+            return -1;
+    }
+    return 1;
+}
+
+void SendLine(int fd, const char* line) {
+    send(fd, line, strlen(line), 0);
+}
+
+// Receives `size` bytes into the scratch file through a write buffer.
+bool SpoolTrace(int fd, FS_Archive sdmc, u64 size, u8* buffer) {
+    FSUSER_DeleteFile(sdmc, fsMakePath(PATH_ASCII, kScratchPath));
+
+    Handle file;
+    if (R_FAILED(FSUSER_OpenFile(&file, sdmc, fsMakePath(PATH_ASCII, kScratchPath),
+                                 FS_OPEN_WRITE | FS_OPEN_CREATE, 0)))
+        return false;
+
+    u64 pos = 0;
+    bool ok = true;
+    while (pos < size && ok) {
+        u32 chunk = (size - pos > kSpoolBufferSize) ? kSpoolBufferSize : (u32)(size - pos);
+        ok = RecvAll(fd, buffer, chunk);
+        if (ok) {
+            u32 written = 0;
+            ok = R_SUCCEEDED(FSFILE_Write(file, &written, pos, buffer, chunk, 0)) &&
+                 written == chunk;
+        }
+        pos += chunk;
+        if ((pos & 0x7FFFFF) < kSpoolBufferSize)
+            printf("net: %llu/%llu MB\r", pos >> 20, size >> 20);
+    }
+    printf("\n");
+
+    FSFILE_Close(file);
+    return ok;
+}
+
+// The scratch trace and everything derived from it.
+void DeleteScratch(FS_Archive sdmc) {
+    static const char* kPaths[] = {
+        "/netplay.ctf", "/netplay.ctb",
+        "/netplay.ctf.crc", "/netplay.ctb.crc", "/netplay.ctf.fbh",
+    };
+    for (const char* p : kPaths)
+        FSUSER_DeleteFile(sdmc, fsMakePath(PATH_ASCII, p));
+}
+
+} // namespace
+
+int Run(Playlist::ReplayFn replay) {
+    u32* soc_buffer = (u32*)memalign(0x1000, kSocBufferSize);
+    u8* spool_buffer = (u8*)malloc(kSpoolBufferSize);
+    if (!soc_buffer || !spool_buffer) {
+        free(soc_buffer);
+        free(spool_buffer);
+        return 1;
+    }
+
+    if (R_FAILED(socInit(soc_buffer, kSocBufferSize))) {
+        printf("net: socInit failed (Wi-Fi off?)\n");
+        free(soc_buffer);
+        free(spool_buffer);
+        return 1;
+    }
+
+    FS_Archive sdmc = 0;
+    FSUSER_OpenArchive(&sdmc, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""));
+
+    int failed = 0;
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = INADDR_ANY;
+
+    if (listener < 0 || bind(listener, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(listener, 1) < 0) {
+        printf("net: cannot listen on port %u\n", kPort);
+        failed = 1;
+    } else {
+        fcntl(listener, F_SETFL, fcntl(listener, F_GETFL, 0) | O_NONBLOCK);
+
+        struct in_addr host = {(in_addr_t)gethostid()};
+        printf("net: listening on %s:%u; START exits\n", inet_ntoa(host), kPort);
+
+        while (aptMainLoop()) {
+            hidScanInput();
+            if (hidKeysDown() & KEY_START)
+                break;
+
+            int client = accept(listener, nullptr, nullptr);
+            if (client < 0) {
+                gspWaitForVBlank();
+                continue;
+            }
+            fcntl(client, F_SETFL, fcntl(client, F_GETFL, 0) & ~O_NONBLOCK);
+
+            struct timeval tv = {};
+            tv.tv_usec = kRecvTimeoutMs * 1000;
+            setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+            // One trace per request; the connection stays up for the next.
+            RequestHeader req;
+            int waited;
+            while ((waited = RecvRequest(client, &req)) > 0) {
+                char name[256] = {};
+                if (req.magic != kRequestMagic || req.name_len >= sizeof(name) ||
+                    !RecvAll(client, name, req.name_len)) {
+                    printf("net: bad request\n");
+                    break;
+                }
+
+                u64 size = req.size_lo | ((u64)req.size_hi << 32);
+                printf("net: receiving %s (%llu bytes)\n", name, size);
+                if (!SpoolTrace(client, sdmc, size, spool_buffer)) {
+                    printf("net: transfer failed\n");
+                    break;
+                }
+
+                int result = replay(kScratchPath, nullptr, 0);
+                if (result != 0)
+                    failed++;
+
+                char line[300];
+                snprintf(line, sizeof(line), "%s %s\n", name, result == 0 ? "pass" : "FAIL");
+                SendLine(client, line);
+                DeleteScratch(sdmc);
+            }
+            close(client);
+            if (waited < 0)
+                break; // START (or apt teardown) during the idle wait
+        }
+    }
+
+    if (listener >= 0)
+        close(listener);
+    if (sdmc)
+        FSUSER_CloseArchive(sdmc);
+    socExit();
+    free(soc_buffer);
+    free(spool_buffer);
+
+    printf("net: done, %d failed\n", failed);
+    return failed;
+}
+
+} // namespace NetServer
@@ -0,0 +1,32 @@
+// Network replay server (-l).
+//
+// Listens on a TCP port, accepts traces pushed from the build server and
+// replays each one with the normal pipeline, reporting the result back on
+// the same connection. Turns the per-device SD card shuffle into an
+// automated push.
+//
+// Protocol, little-endian, one trace per request on a persistent
+// connection:
+//   u32 magic "CTNP", u32 name_len, u64 trace_size,
+//   name bytes (log label only), trace bytes.
+// The player answers with a single text line: "<name> pass\n" or
+// "<name> FAIL\n".
+//
+// Payload reads and the baked cache need a seekable file, so the trace is
+// spooled to a scratch path on SD first and deleted after the run; the
+// card acts as spill space, never as the transport.
+
+#pragma once
+
+#include <3ds.h>
+
+#include "playlist.h"
+
+namespace NetServer {
+
+// Accepts and replays traces until START is pressed. `replay` has the
+// playlist signature; head staging is not used here. Returns the number
+// of failed traces.
+int Run(Playlist::ReplayFn replay);
+
+} // namespace NetServer
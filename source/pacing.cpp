@@ -0,0 +1,30 @@
+#include "pacing.h"
+
+namespace Pacing {
+
+namespace {
+
+Mode g_mode = kVSync;
+
+} // namespace
+
+void SetMode(Mode mode) {
+    g_mode = mode;
+}
+
+Mode GetMode() {
+    return g_mode;
+}
+
+bool Headless() {
+    return g_mode == kHeadless;
+}
+
+void FrameWait() {
+    // Uncapped mode doesn't wait at all: GX submissions already block on
+    // command list completion, so back-to-back frames stay ordered.
+    if (g_mode == kVSync)
+        gspWaitForVBlank();
+}
+
+} // namespace Pacing
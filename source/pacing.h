@@ -0,0 +1,32 @@
+// Frame pacing policy for replay.
+//
+// CiTrace records no per-frame timestamps, only frame markers; the capture
+// itself ran at VBlank granularity. Paced mode therefore aligns every
+// marker to the next VBlank, reproducing the captured cadence, while
+// uncapped mode runs the pipeline flat out for throughput measurement.
+
+#pragma once
+
+#include <3ds.h>
+
+namespace Pacing {
+
+enum Mode {
+    kVSync,     // one frame marker per VBlank (default)
+    kUncapped,  // no pacing; frames complete as fast as the pipeline allows
+    kHeadless,  // uncapped, and the present path (PPF/PDC) is dropped too
+    kDecoupled, // uncapped, with buffer flips latched at VBlank (present.h)
+};
+
+void SetMode(Mode mode);
+Mode GetMode();
+
+// Headless runs keep the GPU command stream but never present: display
+// transfers and LCD framebuffer reconfiguration are dropped at the
+// register batcher.
+bool Headless();
+
+// Called at every frame marker, after the frame's GPU work is submitted.
+void FrameWait();
+
+} // namespace Pacing
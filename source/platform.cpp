@@ -0,0 +1,36 @@
+#include <cstdio>
+
+#include "platform.h"
+
+namespace Platform {
+
+namespace {
+
+const u32 kOldWindowSize = 512 * 1024;
+const u32 kNewWindowSize = 2 * 1024 * 1024;
+
+bool g_new_3ds = false;
+
+} // namespace
+
+void Init() {
+    APT_CheckNew3DS(&g_new_3ds);
+    if (g_new_3ds) {
+        osSetSpeedupEnable(true);
+        printf("n3DS: 804MHz + L2 enabled, workers on core 2\n");
+    }
+}
+
+bool New3DS() {
+    return g_new_3ds;
+}
+
+int WorkerCore() {
+    return g_new_3ds ? 2 : 1;
+}
+
+u32 StreamWindowSize() {
+    return g_new_3ds ? kNewWindowSize : kOldWindowSize;
+}
+
+} // namespace Platform
@@ -0,0 +1,27 @@
+// Model detection and model-dependent tuning.
+//
+// On a New 3DS the player requests the 804MHz clock and L2 cache, places
+// its worker threads on core 2 (which applications get to themselves, with
+// no AppCpuTimeLimit carve-out), and doubles the stream window size to use
+// the larger FCRAM. Old-model hardware keeps the core-1/syscore layout.
+
+#pragma once
+
+#include <3ds.h>
+
+namespace Platform {
+
+// Call once at boot, after apt is up. Detects the model and enables the
+// n3DS speedup when available.
+void Init();
+
+bool New3DS();
+
+// Preferred core for background I/O threads: 2 on n3DS, 1 (syscore slice)
+// on o3DS. Callers should still fall back if threadCreate fails there.
+int WorkerCore();
+
+// Stream window size for the trace reader's ring.
+u32 StreamWindowSize();
+
+} // namespace Platform
@@ -0,0 +1,190 @@
+#include <3ds.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "platform.h"
+#include "playlist.h"
+
+namespace Playlist {
+
+namespace {
+
+// Span staged from the front of the next trace: comfortably covers the
+// header and every initial-state section of real captures.
+const u32 kHeadStageSize = 512 * 1024;
+
+// Below the reader's prefetch thread so stream reads for the trace that is
+// actually rendering win the SD bus.
+const int kStagePriority = 0x38;
+
+struct StageJob {
+    char path[256];
+    u8* buffer;
+    volatile u32 staged; // bytes read, valid once the thread is joined
+};
+
+void StageEntry(void* arg) {
+    StageJob* job = (StageJob*)arg;
+    job->staged = 0;
+
+    FS_Archive sdmc;
+    if (R_FAILED(FSUSER_OpenArchive(&sdmc, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""))))
+        return;
+
+    Handle file;
+    if (R_SUCCEEDED(FSUSER_OpenFile(&file, sdmc, fsMakePath(PATH_ASCII, job->path),
+                                    FS_OPEN_READ, 0))) {
+        u64 size = 0;
+        FSFILE_GetSize(file, &size);
+        u32 want = (size < kHeadStageSize) ? (u32)size : kHeadStageSize;
+
+        u32 bytes_read = 0;
+        if (R_SUCCEEDED(FSFILE_Read(file, &bytes_read, 0, job->buffer, want)))
+            job->staged = bytes_read;
+        FSFILE_Close(file);
+    }
+
+    FSUSER_CloseArchive(sdmc);
+}
+
+void AppendLog(const char* dir_path, const char* line) {
+    char log_path[300];
+    snprintf(log_path, sizeof(log_path), "%s/replay.log", dir_path);
+
+    FS_Archive sdmc;
+    if (R_FAILED(FSUSER_OpenArchive(&sdmc, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""))))
+        return;
+
+    Handle file;
+    if (R_SUCCEEDED(FSUSER_OpenFile(&file, sdmc, fsMakePath(PATH_ASCII, log_path),
+                                    FS_OPEN_WRITE | FS_OPEN_CREATE, 0))) {
+        u64 end = 0;
+        FSFILE_GetSize(file, &end);
+        u32 written = 0;
+        FSFILE_Write(file, &written, end, line, strlen(line), FS_WRITE_FLUSH);
+        FSFILE_Close(file);
+    }
+
+    FSUSER_CloseArchive(sdmc);
+}
+
+bool ScanDirectory(const char* dir_path, std::vector<std::string>* out) {
+    FS_Archive sdmc;
+    if (R_FAILED(FSUSER_OpenArchive(&sdmc, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""))))
+        return false;
+
+    Handle dir;
+    if (R_FAILED(FSUSER_OpenDirectory(&dir, sdmc, fsMakePath(PATH_ASCII, dir_path)))) {
+        FSUSER_CloseArchive(sdmc);
+        return false;
+    }
+
+    FS_DirectoryEntry entry;
+    u32 read = 0;
+    while (R_SUCCEEDED(FSDIR_Read(dir, &read, 1, &entry)) && read == 1) {
+        char name[262];
+        u32 i = 0;
+        while (i < sizeof(name) - 1 && entry.name[i]) {
+            name[i] = (char)entry.name[i];
+            i++;
+        }
+        name[i] = 0;
+
+        size_t len = strlen(name);
+        if (len > 4 && strcasecmp(name + len - 4, ".ctf") == 0)
+            out->push_back(std::string(dir_path) + "/" + name);
+    }
+
+    FSDIR_Close(dir);
+    FSUSER_CloseArchive(sdmc);
+    return true;
+}
+
+} // namespace
+
+bool IsDirectory(const char* path) {
+    FS_Archive sdmc;
+    if (R_FAILED(FSUSER_OpenArchive(&sdmc, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""))))
+        return false;
+
+    Handle dir;
+    bool is_dir = R_SUCCEEDED(FSUSER_OpenDirectory(&dir, sdmc, fsMakePath(PATH_ASCII, path)));
+    if (is_dir)
+        FSDIR_Close(dir);
+    FSUSER_CloseArchive(sdmc);
+    return is_dir;
+}
+
+int Run(const char* dir_path, ReplayFn replay) {
+    std::vector<std::string> traces;
+    if (!ScanDirectory(dir_path, &traces) || traces.empty()) {
+        printf("no traces under %s\n", dir_path);
+        return 1;
+    }
+
+    printf("playlist: %u traces\n", traces.size());
+
+    u8* stage_buffer[2] = {(u8*)malloc(kHeadStageSize), (u8*)malloc(kHeadStageSize)};
+    StageJob jobs[2];
+    Thread stage_thread = nullptr;
+    int staged_for = -1; // trace index the pending job belongs to
+
+    int failed = 0;
+
+    for (size_t i = 0; i < traces.size(); i++) {
+        // Collect the head staged while the previous trace rendered.
+        const u8* head = nullptr;
+        u32 head_size = 0;
+        if (stage_thread) {
+            threadJoin(stage_thread, U64_MAX);
+            threadFree(stage_thread);
+            stage_thread = nullptr;
+            if (staged_for == (int)i && jobs[i % 2].staged) {
+                head = jobs[i % 2].buffer;
+                head_size = jobs[i % 2].staged;
+            }
+        }
+
+        // Kick off staging of the next trace before this one starts.
+        if (i + 1 < traces.size() && stage_buffer[(i + 1) % 2]) {
+            StageJob* job = &jobs[(i + 1) % 2];
+            strncpy(job->path, traces[i + 1].c_str(), sizeof(job->path) - 1);
+            job->path[sizeof(job->path) - 1] = 0;
+            job->buffer = stage_buffer[(i + 1) % 2];
+            stage_thread = threadCreate(StageEntry, job, 8 * 1024, kStagePriority,
+                                        Platform::WorkerCore(), false);
+            staged_for = (int)(i + 1);
+        }
+
+        printf("[%u/%u] %s\n", i + 1, traces.size(), traces[i].c_str());
+        int result = replay(traces[i].c_str(), head, head_size);
+        if (result != 0)
+            failed++;
+
+        char line[320];
+        snprintf(line, sizeof(line), "%s %s\n", traces[i].c_str(),
+                 result == 0 ? "pass" : "FAIL");
+        AppendLog(dir_path, line);
+
+        hidScanInput();
+        if (hidKeysHeld() & KEY_START)
+            break;
+    }
+
+    if (stage_thread) {
+        threadJoin(stage_thread, U64_MAX);
+        threadFree(stage_thread);
+    }
+
+    free(stage_buffer[0]);
+    free(stage_buffer[1]);
+
+    printf("playlist done: %d failed\n", failed);
+    return failed;
+}
+
+} // namespace Playlist
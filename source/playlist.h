@@ -0,0 +1,26 @@
+// Playlist mode: replay every .ctf in a directory back-to-back.
+//
+// While one trace renders, a thread on the second core stages the next
+// trace's header and initial-state sections (everything before the stream
+// section) into a buffer that the next replay's positioned reads are served
+// from, so back-to-back traces don't stall on SD at the transition. Each
+// trace's pass/fail result is appended to a log on SD.
+
+#pragma once
+
+#include <3ds/types.h>
+
+namespace Playlist {
+
+// Replays one trace; `head`/`head_size` optionally carry the pre-staged
+// header span. Returns 0 on success. Provided by main.cpp.
+typedef int (*ReplayFn)(const char* path, const u8* head, u32 head_size);
+
+// True if `path` is a directory on SD.
+bool IsDirectory(const char* path);
+
+// Replays every .ctf under `dir_path`, appending results to
+// <dir_path>/replay.log. Returns the number of failed traces.
+int Run(const char* dir_path, ReplayFn replay);
+
+} // namespace Playlist
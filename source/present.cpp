@@ -0,0 +1,104 @@
+#include <cstring>
+
+#include "gpu_addr.h"
+#include "present.h"
+
+namespace Present {
+
+namespace {
+
+// Top-screen PDC scanout registers that flip buffers: framebuffer A/B
+// addresses and the A/B select. Everything else in the PDC block (timing,
+// format, stride) passes through the batcher immediately.
+const u32 kFlipRegs[] = {0x468, 0x46C, 0x478, 0x494, 0x498};
+const u32 kFlipRegCount = sizeof(kFlipRegs) / sizeof(kFlipRegs[0]);
+
+bool active = false;
+volatile bool running = false;
+Thread thread = nullptr;
+
+LightLock lock;
+u32 latch_value[kFlipRegCount];
+u8 latch_dirty[kFlipRegCount];
+
+int FlipIndex(u32 offset) {
+    for (u32 i = 0; i < kFlipRegCount; i++) {
+        if (kFlipRegs[i] == offset)
+            return (int)i;
+    }
+    return -1;
+}
+
+void PresenterThread(void* unused) {
+    while (running) {
+        gspWaitForVBlank();
+
+        u32 vals[kFlipRegCount];
+        u32 offs[kFlipRegCount];
+        u32 count = 0;
+
+        LightLock_Lock(&lock);
+        for (u32 i = 0; i < kFlipRegCount; i++) {
+            if (!latch_dirty[i])
+                continue;
+            offs[count] = kFlipRegs[i];
+            vals[count] = latch_value[i];
+            latch_dirty[i] = 0;
+            count++;
+        }
+        LightLock_Unlock(&lock);
+
+        // Applied outside the lock; the replay thread never blocks on gsp.
+        for (u32 i = 0; i < count; i++)
+            GSPGPU_WriteHWRegs(kGspExternalRegBase + offs[i], &vals[i], 4);
+    }
+}
+
+} // namespace
+
+Result Init() {
+    LightLock_Init(&lock);
+    memset(latch_dirty, 0, sizeof(latch_dirty));
+    running = true;
+
+    // Same core as the replay loop, slightly higher priority so a pending
+    // flip lands in the VBlank it was latched for.
+    s32 prio = 0x30;
+    svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+    thread = threadCreate(PresenterThread, nullptr, 8 * 1024, prio - 1, -2, false);
+    if (!thread) {
+        running = false;
+        return -1;
+    }
+
+    active = true;
+    return 0;
+}
+
+void Shutdown() {
+    if (!active)
+        return;
+    running = false;
+    threadJoin(thread, U64_MAX); // wakes at the next VBlank
+    threadFree(thread);
+    thread = nullptr;
+    active = false;
+}
+
+bool Active() {
+    return active;
+}
+
+bool LatchReg(u32 offset, u32 value) {
+    int i = FlipIndex(offset);
+    if (i < 0)
+        return false;
+
+    LightLock_Lock(&lock);
+    latch_value[i] = value;
+    latch_dirty[i] = 1;
+    LightLock_Unlock(&lock);
+    return true;
+}
+
+} // namespace Present
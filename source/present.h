@@ -0,0 +1,36 @@
+// VBlank-decoupled presentation.
+//
+// In vsync pacing the replay loop serializes against the LCD: every frame
+// marker blocks on gspWaitForVBlank. Decoupled mode (-d) lets replay run
+// as fast as the pipeline allows while the panel still shows coherent
+// frames: the trace's top-screen buffer flips (PDC framebuffer address and
+// select writes) are diverted into a latch instead of being submitted, and
+// a presenter thread applies the newest latched flip once per VBlank.
+//
+// The trace's own double-buffered scanout targets act as the buffer ring;
+// the panel always points at the last frame the replay completed. If
+// replay laps the buffer currently scanned out the panel can tear - the
+// price of not throttling the pipeline.
+
+#pragma once
+
+#include <3ds.h>
+
+namespace Present {
+
+// Starts the presenter thread. Call once at startup when decoupled
+// pacing is selected; without a successful Init the latch is inactive
+// and flips pass straight through.
+Result Init();
+
+// Stops the presenter; call before the final VBlank-polled exit loop,
+// which shares the event the presenter waits on.
+void Shutdown();
+
+bool Active();
+
+// Offered every external register write by the batcher. Returns true if
+// the write was a top-screen flip and has been latched for the presenter.
+bool LatchReg(u32 offset, u32 value);
+
+} // namespace Present
@@ -0,0 +1,103 @@
+#include <cstring>
+
+#include "bench.h"
+#include "fb_verify.h"
+#include "gpu_addr.h"
+#include "mem_flush.h"
+#include "pacing.h"
+#include "present.h"
+#include "reg_batch.h"
+
+RegBatch g_reg_batch;
+
+void RegBatch::Queue(u32 offset, u32 value) {
+    // A/B routing: PDC0 is 0x400-0x4FF, PDC1 0x500-0x5FF. The rerouted
+    // offset feeds everything below, shadow included, so elision keeps
+    // mirroring what the hardware register actually holds.
+    if (route != kRouteBoth && offset >= 0x400 && offset < 0x600) {
+        if (offset >= 0x500)
+            return; // each instance's own PDC1 writes have no home
+        if (route == kRouteBottom)
+            offset += 0x100;
+    }
+
+    if (FbVerify::Active())
+        FbVerify::NoteRegWrite(offset, value);
+
+    u32 index = offset / 4;
+
+    // Fast-forward: record the value and never touch the hardware;
+    // triggers are dropped since their frames are being skipped.
+    if (deferred) {
+        if (index < ShadowWords && !IsTriggerReg(offset)) {
+            shadow_valid[index] = 1;
+            shadow[index] = value;
+        }
+        return;
+    }
+
+    // Decoupled pacing: buffer flips go to the presenter's latch and reach
+    // the PDC at the next VBlank instead of mid-frame.
+    if (Present::Active() && Present::LatchReg(offset, value))
+        return;
+
+    // Headless runs never present; the display-transfer and LCD setup
+    // writes would only burn gsp round trips.
+    if (Pacing::Headless() && IsPresentReg(offset))
+        return;
+
+    if (IsTriggerReg(offset)) {
+        // The GPU may read any uploaded memory once the trigger lands;
+        // pending dirty extents must hit RAM first.
+        MemFlush::Commit();
+    } else if (index < ShadowWords) {
+        if (elide && shadow_valid[index] && shadow[index] == value) {
+            elided++;
+            return;
+        }
+        shadow_valid[index] = 1;
+        shadow[index] = value;
+    }
+
+    Push(offset, value);
+}
+
+void RegBatch::Push(u32 offset, u32 value) {
+    if (count > 0 && (offset != base_offset + count * 4 || count == MaxRunWords))
+        Flush();
+
+    if (count == 0)
+        base_offset = offset;
+
+    words[count++] = value;
+}
+
+void RegBatch::SubmitShadow() {
+    // Memory accumulated during the fast-forward must be visible before
+    // the register file that points at it.
+    MemFlush::Commit();
+    for (u32 i = 0; i < ShadowWords; i++) {
+        if (!shadow_valid[i])
+            continue;
+        if (Pacing::Headless() && IsPresentReg(i * 4))
+            continue;
+        Push(i * 4, shadow[i]);
+    }
+    Flush();
+}
+
+void RegBatch::Flush() {
+    if (count == 0)
+        return;
+
+    u64 t0 = Bench::Now();
+    GSPGPU_WriteHWRegs(kGspExternalRegBase + base_offset, words, count * 4);
+    Bench::Add(Bench::kSubmit, t0);
+    submissions++;
+    count = 0;
+}
+
+void RegBatch::ResetShadow() {
+    memset(shadow_valid, 0, sizeof(shadow_valid));
+    elided = 0;
+}
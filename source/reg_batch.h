@@ -0,0 +1,79 @@
+// Batching stage for GPU external register writes.
+//
+// Runs of writes to consecutive register words are queued and submitted to
+// gsp as a single WriteHWRegs call instead of one service round trip per
+// register. Ordering against memory loads and frame boundaries is preserved
+// by flushing the pending run before anything that must observe the writes.
+//
+// A shadow copy of the external register file is kept alongside the queue:
+// writes that would store the value a register already holds are dropped
+// before they reach gsp. Trigger registers always go through - writing them
+// fires work regardless of value. SetElide(false) turns the elimination off
+// for strict-fidelity runs.
+
+#pragma once
+
+#include <3ds.h>
+
+class RegBatch {
+public:
+    // gsp caps a WriteHWRegs transfer at 0x80 bytes.
+    static const u32 MaxRunWords = 32;
+
+    // Word count of the external register block we replay into.
+    static const u32 ShadowWords = 0x1A00 / 4;
+
+    // Queues a write to external register `offset` (relative to physical
+    // 0x10400000). Starts a new run - submitting the pending one - if the
+    // offset doesn't extend the current run. Redundant writes are dropped
+    // unless elision is disabled.
+    void Queue(u32 offset, u32 value);
+
+    // Submits the pending run, if any.
+    void Flush();
+
+    // Screen routing for A/B mode: each replay instance owns one display
+    // controller. kTop drops PDC1 writes; kBottom shifts PDC0 writes onto
+    // PDC1 so the second trace presents on the bottom screen.
+    enum Route { kRouteBoth = 0, kRouteTop, kRouteBottom };
+    void SetRoute(Route r) { route = r; }
+
+    // Deferred mode: writes land in the shadow only and triggers are
+    // dropped, so whole frames can be fast-forwarded without the GPU ever
+    // seeing them. SubmitShadow then replays the accumulated register file
+    // in one batched pass to resume real submission.
+    void SetDeferred(bool on) { deferred = on; }
+    bool Deferred() const { return deferred; }
+    void SubmitShadow();
+
+    // Invalidates the shadow register file. Call at the start of every
+    // replay; the hardware state left by a previous trace is unknown.
+    void ResetShadow();
+
+    void SetElide(bool on) { elide = on; }
+
+    u32 SubmissionCount() const { return submissions; }
+    u32 ElidedCount() const { return elided; }
+
+    // Read-only view of the shadow register file; hold-frame mode snapshots
+    // it to rewind the registers a frame touched.
+    const u32* ShadowValues() const { return shadow; }
+    const u8* ShadowValid() const { return shadow_valid; }
+
+private:
+    void Push(u32 offset, u32 value);
+
+    u32 base_offset = 0;
+    u32 count = 0;
+    u32 words[MaxRunWords];
+    u32 submissions = 0;
+    u32 elided = 0;
+    bool elide = true;
+    bool deferred = false;
+    Route route = kRouteBoth;
+
+    u8 shadow_valid[ShadowWords] = {};
+    u32 shadow[ShadowWords];
+};
+
+extern RegBatch g_reg_batch;
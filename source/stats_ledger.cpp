@@ -0,0 +1,269 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "bench.h"
+#include "crc32.h"
+#include "stats_ledger.h"
+
+namespace StatsLedger {
+
+namespace {
+
+const char* kLedgerPath = "/citrace-stats.bin";
+const char* kCsvPath = "/citrace-stats.csv";
+
+const u32 kLedgerMagic = 0x6C735443; // "CTsl"
+const u32 kLedgerVersion = 1;
+
+// Once the ledger fills, the oldest half is dropped; a nightly farm
+// appends forever otherwise.
+const u32 kMaxRecords = 4096;
+
+struct LedgerHeader {
+    u32 magic;
+    u32 version;
+    u32 record_count;
+    u32 reserved;
+};
+
+const u32 kFlagCrcFail = 1;
+
+struct LedgerRecord {
+    u32 key;
+    u32 build_id;
+    u64 timestamp_ms; // osGetTime at the end of the run
+    u32 wall_us;
+    u32 stage_us[Bench::kStageCount];
+    u32 frames;
+    u32 fb_mismatches;
+    u32 flags;
+    char name[24]; // trace basename, truncated; for humans and the CSV
+};
+
+// Hash of the compile timestamp; good enough to tell farm builds apart.
+u32 BuildId() {
+    static const char kStamp[] = __DATE__ " " __TIME__;
+    return Crc32Update(0, kStamp, sizeof(kStamp) - 1);
+}
+
+// Loads the whole ledger with room for one appended record. Returns null
+// (count 0) if the file is absent or not ours; the ledger restarts then.
+LedgerRecord* LoadLedger(FS_Archive sdmc, u32* count) {
+    *count = 0;
+
+    Handle file;
+    if (R_FAILED(FSUSER_OpenFile(&file, sdmc, fsMakePath(PATH_ASCII, kLedgerPath),
+                                 FS_OPEN_READ, 0)))
+        return nullptr;
+
+    LedgerHeader header;
+    u32 read = 0;
+    if (R_FAILED(FSFILE_Read(file, &read, 0, &header, sizeof(header))) ||
+        read != sizeof(header) || header.magic != kLedgerMagic ||
+        header.version != kLedgerVersion || header.record_count > kMaxRecords) {
+        FSFILE_Close(file);
+        return nullptr;
+    }
+
+    LedgerRecord* records =
+        (LedgerRecord*)malloc((header.record_count + 1) * sizeof(LedgerRecord));
+    if (!records) {
+        FSFILE_Close(file);
+        return nullptr;
+    }
+
+    u32 bytes = header.record_count * sizeof(LedgerRecord);
+    if (R_FAILED(FSFILE_Read(file, &read, sizeof(header), records, bytes)) || read != bytes) {
+        FSFILE_Close(file);
+        free(records);
+        return nullptr;
+    }
+
+    FSFILE_Close(file);
+    *count = header.record_count;
+    return records;
+}
+
+bool SaveLedger(FS_Archive sdmc, const LedgerRecord* records, u32 count) {
+    FSUSER_DeleteFile(sdmc, fsMakePath(PATH_ASCII, kLedgerPath));
+
+    Handle file;
+    if (R_FAILED(FSUSER_OpenFile(&file, sdmc, fsMakePath(PATH_ASCII, kLedgerPath),
+                                 FS_OPEN_WRITE | FS_OPEN_CREATE, 0)))
+        return false;
+
+    LedgerHeader header = {kLedgerMagic, kLedgerVersion, count, 0};
+    u32 written = 0;
+    bool ok = R_SUCCEEDED(FSFILE_Write(file, &written, 0, &header, sizeof(header), 0));
+    ok = ok && R_SUCCEEDED(FSFILE_Write(file, &written, sizeof(header), records,
+                                        count * sizeof(LedgerRecord), 0));
+
+    FSFILE_Close(file);
+    return ok;
+}
+
+const char* Basename(const char* path) {
+    const char* slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+// Percentage change of `now` over `base`, negative when faster.
+int PercentOver(u32 now, u32 base) {
+    if (base == 0)
+        return 0;
+    return (int)(((s64)now - base) * 100 / base);
+}
+
+} // namespace
+
+u32 TraceKey(const void* header, u32 header_size, u64 file_size) {
+    u32 key = Crc32Update(0, header, header_size);
+    return Crc32Update(key, &file_size, sizeof(file_size));
+}
+
+void Record(const char* trace_path, u32 key, u32 wall_us, u32 frames, u32 fb_mismatches,
+            bool crc_ok) {
+    FS_Archive sdmc;
+    if (R_FAILED(FSUSER_OpenArchive(&sdmc, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""))))
+        return;
+
+    u32 count = 0;
+    LedgerRecord* records = LoadLedger(sdmc, &count);
+    if (!records) {
+        records = (LedgerRecord*)malloc(sizeof(LedgerRecord));
+        if (!records) {
+            FSUSER_CloseArchive(sdmc);
+            return;
+        }
+    }
+
+    if (count >= kMaxRecords) {
+        memmove(records, records + count / 2, (count - count / 2) * sizeof(LedgerRecord));
+        count -= count / 2;
+    }
+
+    // Previous run of the same trace, for the regression comparison.
+    const LedgerRecord* prev = nullptr;
+    for (u32 i = count; i > 0; i--) {
+        if (records[i - 1].key == key) {
+            prev = &records[i - 1];
+            break;
+        }
+    }
+
+    LedgerRecord& r = records[count];
+    memset(&r, 0, sizeof(r));
+    r.key = key;
+    r.build_id = BuildId();
+    r.timestamp_ms = osGetTime();
+    r.wall_us = wall_us;
+    for (u32 st = 0; st < Bench::kStageCount; st++)
+        r.stage_us[st] = Bench::RunStageUs((Bench::Stage)st);
+    r.frames = frames;
+    r.fb_mismatches = fb_mismatches;
+    r.flags = crc_ok ? 0 : kFlagCrcFail;
+    strncpy(r.name, Basename(trace_path), sizeof(r.name) - 1);
+    count++;
+
+    if (prev) {
+        int pct = PercentOver(wall_us, prev->wall_us);
+        printf("stats: %lu.%lu ms wall, last %lu.%lu ms (%+d%%)\n", wall_us / 1000,
+               (wall_us % 1000) / 100, prev->wall_us / 1000, (prev->wall_us % 1000) / 100, pct);
+        if (pct > (int)kRegressionPercent)
+            printf("stats: REGRESSION over build %08lx\n", prev->build_id);
+    } else {
+        printf("stats: %lu.%lu ms wall (first run)\n", wall_us / 1000, (wall_us % 1000) / 100);
+    }
+
+    if (!SaveLedger(sdmc, records, count))
+        printf("stats: ledger write failed\n");
+
+    free(records);
+    FSUSER_CloseArchive(sdmc);
+}
+
+int Summary() {
+    FS_Archive sdmc;
+    if (R_FAILED(FSUSER_OpenArchive(&sdmc, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""))))
+        return 0;
+
+    u32 count = 0;
+    LedgerRecord* records = LoadLedger(sdmc, &count);
+    if (!records || count == 0) {
+        printf("stats: ledger is empty\n");
+        free(records);
+        FSUSER_CloseArchive(sdmc);
+        return 0;
+    }
+
+    printf("stats: %lu runs, build %08lx\n", count, BuildId());
+
+    // One line per trace: last run against the best one on record.
+    int flagged = 0;
+    for (u32 i = 0; i < count; i++) {
+        bool seen = false;
+        for (u32 j = 0; j < i && !seen; j++)
+            seen = records[j].key == records[i].key;
+        if (seen)
+            continue;
+
+        u32 runs = 0;
+        u32 best_us = 0;
+        const LedgerRecord* last = nullptr;
+        for (u32 j = i; j < count; j++) {
+            if (records[j].key != records[i].key)
+                continue;
+            runs++;
+            if (best_us == 0 || records[j].wall_us < best_us)
+                best_us = records[j].wall_us;
+            last = &records[j];
+        }
+
+        int pct = PercentOver(last->wall_us, best_us);
+        bool slow = pct > (int)kRegressionPercent;
+        if (slow)
+            flagged++;
+
+        printf("%-24s %3lu runs best %6lu ms last %6lu ms%s%s\n", records[i].name, runs,
+               best_us / 1000, last->wall_us / 1000, slow ? " REGRESSION" : "",
+               (last->flags | last->fb_mismatches) ? " (hash FAIL)" : "");
+    }
+
+    // Full ledger as CSV, for anything the on-device view can't answer.
+    Handle file;
+    FSUSER_DeleteFile(sdmc, fsMakePath(PATH_ASCII, kCsvPath));
+    if (R_SUCCEEDED(FSUSER_OpenFile(&file, sdmc, fsMakePath(PATH_ASCII, kCsvPath),
+                                    FS_OPEN_WRITE | FS_OPEN_CREATE, 0))) {
+        char line[192];
+        u64 pos = 0;
+        u32 written = 0;
+
+        int n = snprintf(line, sizeof(line),
+                         "name,key,build,timestamp_ms,wall_us,read_us,upload_us,submit_us,"
+                         "gpu_us,frames,fb_mismatches,crc_ok\n");
+        FSFILE_Write(file, &written, pos, line, n, 0);
+        pos += n;
+
+        for (u32 i = 0; i < count; i++) {
+            const LedgerRecord& r = records[i];
+            n = snprintf(line, sizeof(line),
+                         "%s,%08lx,%08lx,%llu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%d\n", r.name, r.key,
+                         r.build_id, r.timestamp_ms, r.wall_us, r.stage_us[Bench::kRead],
+                         r.stage_us[Bench::kUpload], r.stage_us[Bench::kSubmit],
+                         r.stage_us[Bench::kGpu], r.frames, r.fb_mismatches,
+                         (r.flags & kFlagCrcFail) ? 0 : 1);
+            FSFILE_Write(file, &written, pos, line, n, 0);
+            pos += n;
+        }
+
+        FSFILE_Close(file);
+        printf("stats: wrote %s\n", kCsvPath);
+    }
+
+    free(records);
+    FSUSER_CloseArchive(sdmc);
+    return flagged;
+}
+
+} // namespace StatsLedger
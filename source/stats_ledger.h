@@ -0,0 +1,38 @@
+// Per-trace replay statistics ledger.
+//
+// Every clean full replay appends one fixed-size record to a binary ledger
+// on SD: trace key, build id, wall time, per-stage totals, frame count and
+// hash results. Records are keyed by a hash of the trace header and file
+// size, so the same trace is tracked across renames and farm machines.
+//
+// After appending, the run is compared against the previous run of the same
+// trace and flagged on console if it regressed past the threshold - the
+// nightly farm needs no host-side tooling to spot a slow build. -e prints a
+// per-trace summary and exports the whole ledger as CSV.
+
+#pragma once
+
+#include <3ds.h>
+
+namespace StatsLedger {
+
+// Wall-time regression (vs the previous run of the same trace) above this
+// gets flagged on console and in the summary.
+const u32 kRegressionPercent = 10;
+
+// Identity of a trace: CRC over its header plus the file size. Stable
+// across renames, changes whenever the capture does.
+u32 TraceKey(const void* header, u32 header_size, u64 file_size);
+
+// Appends one run to the ledger and prints the comparison against the
+// previous run of the same trace. Call only for clean, full replays;
+// partial or aborted runs would poison the baseline.
+void Record(const char* trace_path, u32 key, u32 wall_us, u32 frames, u32 fb_mismatches,
+            bool crc_ok);
+
+// Prints the per-trace summary (runs, best/last wall time, regressions)
+// and writes the full ledger as CSV next to it. Returns the number of
+// traces whose last run is flagged.
+int Summary();
+
+} // namespace StatsLedger
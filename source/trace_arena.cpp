@@ -0,0 +1,35 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include "trace_arena.h"
+
+TraceArena g_trace_arena;
+
+Result TraceArena::Init(u32 bytes) {
+    base = (u8*)malloc(bytes);
+    if (!base)
+        return -1;
+    size = bytes;
+    used = 0;
+    return 0;
+}
+
+void TraceArena::Shutdown() {
+    free(base);
+    base = nullptr;
+    size = used = 0;
+}
+
+void TraceArena::Reset() {
+    used = 0;
+}
+
+void* TraceArena::Alloc(u32 alloc_size, u32 align) {
+    u32 offset = (used + align - 1) & ~(align - 1);
+    if (offset + alloc_size > size) {
+        printf("trace arena exhausted (%lu + %lu > %lu)\n", offset, alloc_size, size);
+        return nullptr;
+    }
+    used = offset + alloc_size;
+    return base + offset;
+}
@@ -0,0 +1,41 @@
+// Bump allocator for per-trace CPU-side state.
+//
+// Section buffers, the memory map's range table and similar bookkeeping all
+// come from one block reserved at startup: loading a trace performs no heap
+// allocations that survive it, and teardown between traces is a single
+// reset. This keeps the regular heap (and with it linearMem, which the
+// default allocator spills into) from fragmenting across long playlist
+// sessions. Payload memory has its own arena in MemMap; this one is for
+// everything else.
+
+#pragma once
+
+#include <3ds/types.h>
+
+class TraceArena {
+public:
+    static const u32 DefaultSize = 1024 * 1024;
+
+    Result Init(u32 bytes = DefaultSize);
+    void Shutdown();
+
+    // Invalidates every outstanding allocation; O(1) between traces.
+    void Reset();
+
+    void* Alloc(u32 size, u32 align = 8);
+
+    template <typename T>
+    T* AllocArray(u32 count) {
+        return (T*)Alloc(count * sizeof(T), alignof(T) > 8 ? alignof(T) : 8);
+    }
+
+    u32 BytesUsed() const { return used; }
+    u32 BytesTotal() const { return size; }
+
+private:
+    u8* base = nullptr;
+    u32 size = 0;
+    u32 used = 0;
+};
+
+extern TraceArena g_trace_arena;
@@ -0,0 +1,202 @@
+#include <cstdio>
+#include <cstring>
+
+#include "trace_check.h"
+
+namespace TraceCheck {
+
+namespace {
+
+// Section table entry reduced to byte extents for the overlap check.
+struct Extent {
+    u64 start;
+    u64 end;
+    const char* name;
+};
+
+bool CheckSection(u64 file_size, u32 offset, u32 size_words, const char* name,
+                  Extent* extents, u32* extent_count) {
+    if (size_words == 0)
+        return true;
+
+    u64 start = offset;
+    u64 end = start + (u64)size_words * 4;
+    if (start < sizeof(CiTrace::CTHeader) || end > file_size) {
+        printf("trace check: %s section out of bounds (%lu..%llu of %llu)\n",
+               name, offset, end, file_size);
+        return false;
+    }
+
+    extents[*extent_count] = {start, end, name};
+    (*extent_count)++;
+    return true;
+}
+
+bool PlausibleLoadTarget(u32 addr, u32 size) {
+    u64 end = (u64)addr + size;
+    if (addr >= 0x18000000 && end <= 0x18600000) // VRAM
+        return true;
+    if (addr >= 0x20000000 && end <= 0x28000000) // FCRAM
+        return true;
+    return false;
+}
+
+} // namespace
+
+bool Run(TraceReader& reader, const CiTrace::CTHeader& header) {
+    u64 file_size = reader.FileSize();
+    const auto& s = header.initial_state_offsets;
+
+    // Section table: every section in bounds, none overlapping another.
+    Extent extents[11];
+    u32 extent_count = 0;
+    bool ok =
+        CheckSection(file_size, s.gpu_registers, s.gpu_registers_size, "gpu regs", extents, &extent_count) &&
+        CheckSection(file_size, s.lcd_registers, s.lcd_registers_size, "lcd regs", extents, &extent_count) &&
+        CheckSection(file_size, s.pica_registers, s.pica_registers_size, "pica regs", extents, &extent_count) &&
+        CheckSection(file_size, s.default_attributes, s.default_attributes_size, "default attrs", extents, &extent_count) &&
+        CheckSection(file_size, s.vs_program_binary, s.vs_program_binary_size, "vs program", extents, &extent_count) &&
+        CheckSection(file_size, s.vs_swizzle_data, s.vs_swizzle_data_size, "vs swizzle", extents, &extent_count) &&
+        CheckSection(file_size, s.vs_float_uniforms, s.vs_float_uniforms_size, "vs uniforms", extents, &extent_count) &&
+        CheckSection(file_size, s.gs_program_binary, s.gs_program_binary_size, "gs program", extents, &extent_count) &&
+        CheckSection(file_size, s.gs_swizzle_data, s.gs_swizzle_data_size, "gs swizzle", extents, &extent_count) &&
+        CheckSection(file_size, s.gs_float_uniforms, s.gs_float_uniforms_size, "gs uniforms", extents, &extent_count);
+    if (!ok)
+        return false;
+
+    u64 stream_start = header.stream_offset;
+    u64 stream_end = stream_start + (u64)header.stream_size * sizeof(CiTrace::CTStreamElement);
+    if (header.stream_size > 0) {
+        if (stream_start < sizeof(CiTrace::CTHeader) || stream_end > file_size) {
+            printf("trace check: stream out of bounds (%llu..%llu of %llu)\n",
+                   stream_start, stream_end, file_size);
+            return false;
+        }
+        extents[extent_count++] = {stream_start, stream_end, "stream"};
+    }
+
+    // Insertion sort by start offset; the table is tiny.
+    for (u32 i = 1; i < extent_count; i++) {
+        Extent e = extents[i];
+        u32 j = i;
+        while (j > 0 && extents[j - 1].start > e.start) {
+            extents[j] = extents[j - 1];
+            j--;
+        }
+        extents[j] = e;
+    }
+    for (u32 i = 1; i < extent_count; i++) {
+        if (extents[i].start < extents[i - 1].end) {
+            printf("trace check: %s section overlaps %s\n", extents[i - 1].name,
+                   extents[i].name);
+            return false;
+        }
+    }
+
+    // One sequential pass over the stream, a fixed stack buffer at a time.
+    // Memory-load payloads are only bounds-checked, not read.
+    CiTrace::CTStreamElement chunk[128];
+    u64 pos = stream_start;
+    u32 remaining = header.stream_size;
+    u32 index = 0;
+
+    while (remaining > 0) {
+        u32 batch = (remaining > 128) ? 128 : remaining;
+        if (R_FAILED(reader.ReadAt(pos, chunk, batch * sizeof(chunk[0])))) {
+            printf("trace check: stream read failed at element %lu\n", index);
+            return false;
+        }
+
+        for (u32 i = 0; i < batch; i++, index++) {
+            const CiTrace::CTStreamElement& e = chunk[i];
+            switch (e.type) {
+            case CiTrace::FrameMarker:
+                break;
+            case CiTrace::MemoryLoad: {
+                const CiTrace::CTMemoryLoad& load = e.memory_load;
+                u64 end = (u64)load.file_offset + load.size;
+                if (load.size == 0 || end > file_size) {
+                    printf("trace check: element %lu: load payload out of bounds\n", index);
+                    return false;
+                }
+                if (end > stream_start && load.file_offset < stream_end) {
+                    printf("trace check: element %lu: load payload inside stream\n", index);
+                    return false;
+                }
+                if (!PlausibleLoadTarget(load.physical_address, load.size)) {
+                    printf("trace check: element %lu: load target %08lx+%lu not memory\n",
+                           index, load.physical_address, load.size);
+                    return false;
+                }
+                break;
+            }
+            case CiTrace::RegisterWrite: {
+                const CiTrace::CTRegisterWrite& w = e.register_write;
+                if (w.size < CiTrace::CTRegisterWrite::SIZE_8 ||
+                    w.size > CiTrace::CTRegisterWrite::SIZE_64) {
+                    printf("trace check: element %lu: bad write size %lx\n", index,
+                           (u32)w.size);
+                    return false;
+                }
+                if (w.physical_address < 0x10100000 || w.physical_address >= 0x10500000) {
+                    printf("trace check: element %lu: write outside MMIO (%08lx)\n",
+                           index, w.physical_address);
+                    return false;
+                }
+                break;
+            }
+            default:
+                printf("trace check: element %lu: unknown type %lx\n", index,
+                       (u32)e.type);
+                return false;
+            }
+        }
+
+        pos += batch * sizeof(chunk[0]);
+        remaining -= batch;
+    }
+
+    return true;
+}
+
+bool FinishCrc(const char* path, TraceReader& reader) {
+    const u32 kCrcFileMagic = 0x31435243; // "CRC1"
+
+    u32 crc;
+    if (!reader.StreamCrc(&crc))
+        return true;
+
+    char crc_path[256];
+    snprintf(crc_path, sizeof(crc_path), "%s.crc", path);
+
+    FS_Archive sdmc;
+    if (R_FAILED(FSUSER_OpenArchive(&sdmc, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""))))
+        return true;
+
+    bool ok = true;
+    Handle file;
+
+    if (R_SUCCEEDED(FSUSER_OpenFile(&file, sdmc, fsMakePath(PATH_ASCII, crc_path),
+                                    FS_OPEN_READ, 0))) {
+        u32 header[2] = {};
+        u32 bytes_read = 0;
+        FSFILE_Read(file, &bytes_read, 0, header, sizeof(header));
+        if (header[0] != kCrcFileMagic || header[1] != crc) {
+            printf("crc: %s is %08lx, expected %08lx\n", path, crc, header[1]);
+            ok = false;
+        }
+        FSFILE_Close(file);
+    } else if (R_SUCCEEDED(FSUSER_OpenFile(&file, sdmc, fsMakePath(PATH_ASCII, crc_path),
+                                           FS_OPEN_WRITE | FS_OPEN_CREATE, 0))) {
+        u32 header[2] = {kCrcFileMagic, crc};
+        u32 written = 0;
+        FSFILE_Write(file, &written, 0, header, sizeof(header), FS_WRITE_FLUSH);
+        FSFILE_Close(file);
+        printf("crc: recorded %08lx for %s\n", crc, crc_path);
+    }
+
+    FSUSER_CloseArchive(sdmc);
+    return ok;
+}
+
+} // namespace TraceCheck
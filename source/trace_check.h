@@ -0,0 +1,28 @@
+// Pre-replay validation of a CiTrace file.
+//
+// One sequential pass over the header section table and the element stream,
+// checking bounds, section overlap and per-element sanity before any GPU
+// state is touched. Uses a fixed stack buffer - no allocation - so it is
+// cheap enough to stay enabled unconditionally.
+
+#pragma once
+
+#include "citrace.h"
+#include "trace_reader.h"
+
+namespace TraceCheck {
+
+// Returns false - after printing what was wrong and where - if the trace
+// would crash or corrupt a replay. A false return means the GPU was never
+// touched and the trace should be skipped.
+bool Run(TraceReader& reader, const CiTrace::CTHeader& header);
+
+// Settles the background stream CRC after a full sequential replay of
+// `path`: compares against the <path>.crc sidecar, recording it on the
+// first covered run. Returns false only on a mismatch; a run that didn't
+// cover the whole stream (seek, abort, error) is a silent no-op. The CRC
+// itself was computed window-by-window on the prefetch thread, so the
+// check costs nothing at this point.
+bool FinishCrc(const char* path, TraceReader& reader);
+
+} // namespace TraceCheck
@@ -0,0 +1,355 @@
+#include <cstring>
+
+#include "bench.h"
+#include "crc32.h"
+#include "platform.h"
+#include "trace_reader.h"
+
+// Runs above the main thread so a blocked FSFILE_Read never steals time
+// from decode/submission on core 0.
+static const int kPrefetchPriority = 0x2D;
+static const u32 kPrefetchStackSize = 16 * 1024;
+
+static u32 g_ring_depth = TraceReader::DefaultRingDepth;
+
+void TraceReader::SetRingDepth(u32 depth) {
+    if (depth < 2)
+        depth = 2;
+    if (depth > MaxWindows)
+        depth = MaxWindows;
+    g_ring_depth = depth;
+}
+
+Result TraceReader::Open(const char* path) {
+    Result res = FSUSER_OpenArchive(&sdmc, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""));
+    if (R_FAILED(res))
+        return res;
+
+    res = FSUSER_OpenFile(&file, sdmc, fsMakePath(PATH_ASCII, path), FS_OPEN_READ, 0);
+    if (R_FAILED(res)) {
+        FSUSER_CloseArchive(sdmc);
+        sdmc = 0;
+        return res;
+    }
+
+    // Second handle for positioned reads, so they never share a session
+    // with the prefetch thread.
+    res = FSUSER_OpenFile(&file_pread, sdmc, fsMakePath(PATH_ASCII, path), FS_OPEN_READ, 0);
+    if (R_FAILED(res)) {
+        Close();
+        return res;
+    }
+
+    res = FSFILE_GetSize(file, &file_size);
+    if (R_FAILED(res)) {
+        Close();
+        return res;
+    }
+
+    // Window buffers come from the linear heap so later stages can hand them
+    // to the GPU or DMA engine without another copy.
+    window_size = Platform::StreamWindowSize();
+    num_windows = g_ring_depth;
+    for (u32 i = 0; i < num_windows; i++) {
+        window[i] = (u8*)linearAlloc(window_size);
+        if (!window[i]) {
+            Close();
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void TraceReader::Close() {
+    StopPrefetch();
+
+    for (u32 i = 0; i < num_windows; i++) {
+        if (window[i]) {
+            linearFree(window[i]);
+            window[i] = nullptr;
+        }
+    }
+    if (file_pread) {
+        FSFILE_Close(file_pread);
+        file_pread = 0;
+    }
+    if (file) {
+        FSFILE_Close(file);
+        file = 0;
+    }
+    if (sdmc) {
+        FSUSER_CloseArchive(sdmc);
+        sdmc = 0;
+    }
+}
+
+void TraceReader::SetHeadCache(const u8* data, u32 size) {
+    head_cache = data;
+    head_cache_size = size;
+}
+
+Result TraceReader::ReadAt(u64 offset, void* dest, u32 size) {
+    if (head_cache && offset + size <= head_cache_size) {
+        memcpy(dest, head_cache + offset, size);
+        return 0;
+    }
+
+    u64 t0 = Bench::Now();
+    u32 bytes_read = 0;
+    Result res = FSFILE_Read(file_pread, &bytes_read, offset, dest, size);
+    Bench::Add(Bench::kRead, t0);
+    if (R_FAILED(res))
+        return res;
+    return (bytes_read == size) ? 0 : -1;
+}
+
+Result TraceReader::FillWindow(int which, u64 offset) {
+    window_offset[which] = offset;
+    window_valid[which] = 0;
+
+    if (offset >= stream_end)
+        return 0;
+
+    u32 want = window_size;
+    if (offset + want > stream_end)
+        want = (u32)(stream_end - offset);
+
+    u64 t0 = Bench::Now();
+    u32 bytes_read = 0;
+    Result res = FSFILE_Read(file, &bytes_read, offset, window[which], want);
+    Bench::Add(Bench::kRead, t0);
+    if (R_FAILED(res))
+        return res;
+
+    window_valid[which] = bytes_read;
+
+    // Fills are sequential per BeginStream, so each one extends the rolling
+    // CRC; refills in the synchronous fallback overlap already-hashed bytes
+    // and only the new tail is added. A fill that leaves a gap (there is no
+    // such path today) forfeits the value rather than corrupting it.
+    if (crc_ok) {
+        if (crc_next >= offset && crc_next < offset + bytes_read) {
+            u32 skip = (u32)(crc_next - offset);
+            stream_crc = Crc32Update(stream_crc, window[which] + skip, bytes_read - skip);
+            crc_next += bytes_read - skip;
+        } else if (crc_next < offset) {
+            crc_ok = false;
+        }
+    }
+
+    return (bytes_read == want) ? 0 : -1;
+}
+
+bool TraceReader::StreamCrc(u32* out) const {
+    if (!crc_ok || crc_next < stream_end)
+        return false;
+    *out = stream_crc;
+    return true;
+}
+
+// --- prefetch thread ------------------------------------------------------
+
+void TraceReader::PrefetchEntry(void* arg) {
+    ((TraceReader*)arg)->PrefetchLoop();
+}
+
+void TraceReader::PrefetchLoop() {
+    while (true) {
+        LightSemaphore_Acquire(&sem_free, 1);
+        if (prefetch_stop)
+            break;
+        if (fill_pos >= stream_end)
+            break; // everything buffered; consumer never waits past the end
+
+        if (R_FAILED(FillWindow(fill_index, fill_pos))) {
+            // Hand the consumer an empty window so it wakes up and fails.
+            prefetch_error = true;
+            window_valid[fill_index] = 0;
+            LightSemaphore_Release(&sem_filled, 1);
+            break;
+        }
+
+        fill_pos += window_valid[fill_index];
+        fill_index = (fill_index + 1) % num_windows;
+        LightSemaphore_Release(&sem_filled, 1);
+    }
+}
+
+void TraceReader::StopPrefetch() {
+    if (prefetch_thread) {
+        prefetch_stop = true;
+        LightSemaphore_Release(&sem_free, 1);
+        threadJoin(prefetch_thread, U64_MAX);
+        threadFree(prefetch_thread);
+        prefetch_thread = nullptr;
+    }
+    threaded = false;
+    prefetch_stop = false;
+    prefetch_error = false;
+    active = -1;
+}
+
+Result TraceReader::BeginStream(u64 offset, u64 size) {
+    StopPrefetch();
+
+    stream_pos = offset;
+    stream_end = offset + size;
+    // Fills start at the sector boundary below the requested offset; the
+    // consumer just begins partway into the first window.
+    fill_pos = offset & ~(u64)(SectorSize - 1);
+    fill_index = 0;
+    consumer_index = 0;
+    active = -1;
+    stream_crc = 0;
+    crc_next = offset;
+    crc_ok = true;
+    for (u32 i = 0; i < num_windows; i++)
+        window_valid[i] = 0;
+
+    LightSemaphore_Init(&sem_free, num_windows, num_windows);
+    LightSemaphore_Init(&sem_filled, 0, num_windows);
+
+    // Core 2 on n3DS, otherwise core 1 (which needs APT_SetAppCpuTimeLimit
+    // to have granted us syscore time). If neither works we fall back to
+    // synchronous refills.
+    prefetch_thread = threadCreate(PrefetchEntry, this, kPrefetchStackSize,
+                                   kPrefetchPriority, Platform::WorkerCore(), false);
+    if (!prefetch_thread && Platform::WorkerCore() != 1)
+        prefetch_thread = threadCreate(PrefetchEntry, this, kPrefetchStackSize,
+                                       kPrefetchPriority, 1, false);
+    threaded = prefetch_thread != nullptr;
+    return 0;
+}
+
+int TraceReader::AcquireActive() {
+    if (active >= 0) {
+        if (stream_pos < window_offset[active] + window_valid[active])
+            return active;
+        ReleaseActive();
+    }
+
+    if (threaded) {
+        LightSemaphore_Acquire(&sem_filled, 1);
+        if (prefetch_error)
+            return -1;
+        active = consumer_index;
+        consumer_index = (consumer_index + 1) % num_windows;
+        if (window_valid[active] == 0)
+            return -1;
+        return active;
+    }
+
+    // Synchronous fallback: one window, refilled in place at the sector
+    // boundary below the current position.
+    if (R_FAILED(FillWindow(0, stream_pos & ~(u64)(SectorSize - 1))) ||
+        stream_pos >= window_offset[0] + window_valid[0])
+        return -1;
+    active = 0;
+    return 0;
+}
+
+void TraceReader::ReleaseActive() {
+    if (active < 0)
+        return;
+    if (threaded)
+        LightSemaphore_Release(&sem_free, 1);
+    active = -1;
+}
+
+const void* TraceReader::FetchStream(u32 size) {
+    if (stream_pos + size > stream_end)
+        return nullptr;
+
+    int w = AcquireActive();
+    if (w < 0)
+        return nullptr;
+
+    u64 in_window = stream_pos - window_offset[w];
+    u32 avail = window_valid[w] - (u32)in_window;
+
+    if (avail >= size) {
+        const void* p = window[w] + in_window;
+        stream_pos += size;
+        return p;
+    }
+
+    // Record straddles a window boundary: tail of this window plus the head
+    // of the next, re-assembled in the carry buffer.
+    if (size > sizeof(carry))
+        return nullptr;
+
+    memcpy(carry, window[w] + in_window, avail);
+    stream_pos += avail;
+    ReleaseActive();
+
+    w = AcquireActive();
+    if (w < 0)
+        return nullptr;
+
+    memcpy(carry + avail, window[w], size - avail);
+    stream_pos += size - avail;
+    return carry;
+}
+
+Result TraceReader::ReadStream(void* dest, u32 size) {
+    if (stream_pos + size > stream_end)
+        return -1;
+
+    u8* out = (u8*)dest;
+    while (size > 0) {
+        int w = AcquireActive();
+        if (w < 0)
+            return -1;
+
+        u64 in_window = stream_pos - window_offset[w];
+        u32 avail = window_valid[w] - (u32)in_window;
+        u32 chunk = (avail < size) ? avail : size;
+
+        memcpy(out, window[w] + in_window, chunk);
+        out += chunk;
+        stream_pos += chunk;
+        size -= chunk;
+
+        if (chunk == avail)
+            ReleaseActive();
+    }
+    return 0;
+}
+
+Result TraceReader::SkipStream(u64 bytes) {
+    if (bytes == 0)
+        return 0;
+    if (stream_pos + bytes > stream_end)
+        return -1;
+
+    u64 target = stream_pos + bytes;
+
+    if (!threaded) {
+        stream_pos = target;
+        return 0;
+    }
+
+    // A skip past everything the ring will ever hold is cheaper as a
+    // restart than as draining windows one by one.
+    if (bytes > (u64)num_windows * window_size) {
+        u64 end = stream_end;
+        Result res = BeginStream(target, end - target);
+        // The skipped bytes were never hashed; BeginStream reset the CRC
+        // state, but a restart mid-range forfeits the value for good.
+        crc_ok = false;
+        return res;
+    }
+
+    while (true) {
+        int w = AcquireActive();
+        if (w < 0)
+            return -1;
+        if (target <= window_offset[w] + window_valid[w]) {
+            stream_pos = target;
+            return 0;
+        }
+        stream_pos = window_offset[w] + window_valid[w];
+        ReleaseActive();
+    }
+}
@@ -0,0 +1,126 @@
+// Windowed reader over a .ctf on SD.
+//
+// The header, the initial-state sections and memory-load payloads are fetched
+// with positioned reads; the stream section is consumed sequentially through
+// a ring of fixed-size windows, so the file never needs to be resident in RAM
+// and playback can start as soon as the header and initial state have been
+// read.
+//
+// When the system grants us a second core, a producer thread there keeps the
+// ring filled while the main thread decodes and submits, hiding SD latency
+// entirely; otherwise windows are refilled synchronously on demand. The ring
+// is single-producer/single-consumer: indices are owned by one side each and
+// the two semaphores carry the hand-off.
+
+#pragma once
+
+#include <3ds.h>
+
+class TraceReader {
+public:
+    // Ring windows bound the reader's memory use. The window size comes
+    // from Platform (larger on n3DS) and must be a multiple of the SD
+    // sector size; window fills are issued sector-aligned, since SD
+    // throughput collapses on unaligned requests.
+    static const u32 MaxWindows = 8;
+    static const u32 DefaultRingDepth = 3;
+    static const u32 SectorSize = 512;
+
+    // Read-ahead depth (ring window count) for readers opened after the
+    // call; clamped to [2, MaxWindows].
+    static void SetRingDepth(u32 depth);
+
+    Result Open(const char* path);
+    void Close();
+
+    u64 FileSize() const { return file_size; }
+
+    // Positioned read, bypassing the stream windows. Uses its own file
+    // handle so it never races the prefetch thread.
+    Result ReadAt(u64 offset, void* dest, u32 size);
+
+    // Serves positioned reads inside [0, size) from `data` instead of SD;
+    // used by playlist mode to hand over a pre-staged header/initial-state
+    // span. The buffer must outlive the reader.
+    void SetHeadCache(const u8* data, u32 size);
+
+    // Begins sequential consumption of the byte range [offset, offset+size)
+    // and starts (or restarts) prefetching.
+    Result BeginStream(u64 offset, u64 size);
+
+    // Returns a pointer to the next `size` bytes of the stream and advances
+    // past them, blocking on the prefetcher as needed. Returns nullptr at
+    // end of stream or on I/O error. Records that straddle a window boundary
+    // are re-assembled in a carry buffer, so the returned pointer is only
+    // valid until the next call.
+    const void* FetchStream(u32 size);
+
+    // Copies the next `size` stream bytes into `dest` and advances past
+    // them. Unlike FetchStream there is no length limit: the copy spans as
+    // many windows as needed, so bulk payloads are served from the
+    // prefetched ring instead of hitting SD a second time.
+    Result ReadStream(void* dest, u32 size);
+
+    // Advances past `bytes` of stream without handing them to the caller.
+    Result SkipStream(u64 bytes);
+
+    u64 StreamRemaining() const { return stream_end - stream_pos; }
+    u64 StreamPos() const { return stream_pos; }
+
+    // CRC32 of the streamed range, computed window-by-window as fills
+    // complete (on the prefetch thread when there is one). Returns true and
+    // the value only if the whole range set up by the last BeginStream was
+    // covered by strictly sequential fills; a restart mid-range (long
+    // SkipStream) forfeits it.
+    bool StreamCrc(u32* out) const;
+
+private:
+    static void PrefetchEntry(void* arg);
+    void PrefetchLoop();
+
+    void StopPrefetch();
+    Result FillWindow(int which, u64 offset);
+
+    // Consumer side: makes sure the window holding stream_pos is resident,
+    // returns its index or -1.
+    int AcquireActive();
+    void ReleaseActive();
+
+    Handle file = 0;        // prefetch/stream handle
+    Handle file_pread = 0;  // positioned-read handle
+    const u8* head_cache = nullptr;
+    u32 head_cache_size = 0;
+    FS_Archive sdmc = 0;
+    u64 file_size = 0;
+
+    u32 window_size = 0;
+    u32 num_windows = 0;
+    u8* window[MaxWindows] = {};
+    u64 window_offset[MaxWindows] = {};
+    u32 window_valid[MaxWindows] = {};
+
+    // Consumer state.
+    int active = -1;        // window holding stream_pos, -1 if none acquired
+    int consumer_index = 0; // next ring slot the consumer will acquire
+    u64 stream_pos = 0;
+    u64 stream_end = 0;
+
+    // Producer state.
+    u64 fill_pos = 0;
+    int fill_index = 0;
+
+    // Rolling stream CRC, advanced by FillWindow on the producer side.
+    u32 stream_crc = 0;
+    u64 crc_next = 0;
+    bool crc_ok = false;
+
+    Thread prefetch_thread = nullptr;
+    LightSemaphore sem_free;
+    LightSemaphore sem_filled;
+    volatile bool prefetch_stop = false;
+    volatile bool prefetch_error = false;
+    bool threaded = false;
+
+    // Re-assembly buffer for a record split across two windows.
+    u8 carry[64];
+};